@@ -0,0 +1,828 @@
+//
+// decoder_bench.cpp
+// Copyright (C) 2018 Marius Greuel
+// SPDX-License-Identifier: GPL-3.0-or-later
+//
+
+// Replays edge and byte traces through the unchanged PPM, PCM and SRXL decoder
+// templates on the host. Mock timer and USART policies stand in for Timer1 and
+// USART1, and the output compare interrupts are raised from the trace times.
+// Without trace files, it generates traces with known frames and injected errors,
+// and checks every decoded frame against the frame that was sent.
+
+#include <algorithm>
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include <atl/memory.h>
+#include <shared/pcm_receiver.h>
+#include <shared/ppm_receiver.h>
+#include <shared/srxl_receiver.h>
+#include <shared/timer_traits.h>
+
+#ifndef TIMER1_PRESCALER
+#define TIMER1_PRESCALER 8
+#endif
+
+// The tick rate of Timer1. Each decoder gets its own counter and compare register.
+template<uint8_t id>
+class MockTimerT : public TimerTraits<F_CPU, TIMER1_PRESCALER>
+{
+public:
+    using TableMemory = atl::RamTraits;
+
+    static void Initialize()
+    {
+    }
+
+    static uint16_t& TCNT()
+    {
+        return m_tcnt;
+    }
+
+    static uint16_t& OCR()
+    {
+        return m_ocr;
+    }
+
+private:
+    static uint16_t m_tcnt;
+    static uint16_t m_ocr;
+};
+
+template<uint8_t id>
+uint16_t MockTimerT<id>::m_tcnt;
+
+template<uint8_t id>
+uint16_t MockTimerT<id>::m_ocr;
+
+using Timer = MockTimerT<0>;
+using PpmTimer = MockTimerT<1>;
+using SrxlTimer = MockTimerT<2>;
+
+class MockUsart
+{
+public:
+    static void Initialize(uint32_t)
+    {
+    }
+};
+
+/////////////////////////////////////////////////////////////////////////////
+
+struct Event
+{
+    enum Type : uint8_t
+    {
+        FallingEdge,
+        RisingEdge,
+        Data,
+    };
+
+    uint32_t m_time; // Extended timer ticks
+    Type m_type;
+    uint8_t m_data;
+};
+
+struct ExpectedFrame
+{
+    uint32_t m_time;
+    std::vector<uint16_t> m_values;
+};
+
+struct Trace
+{
+    std::vector<Event> m_events;
+    std::vector<ExpectedFrame> m_frames;
+    bool m_isRecorded = false;
+};
+
+struct Results
+{
+    uint32_t m_frames;
+    uint32_t m_matched;
+    uint32_t m_mismatched;
+    uint32_t m_unexpected;
+    uint32_t m_checksumErrors;
+    uint32_t m_shortFrames;
+    uint32_t m_longFrames;
+    uint32_t m_timeouts;
+};
+
+// Counts the hook calls of a decoder and matches each frame with the frame sent at that time.
+// The decoders publish a frame before they call OnFrameReceived(), so the hook can read it.
+template<typename T>
+class BenchReceiverT
+{
+public:
+    void SetExpectedFrames(const std::vector<ExpectedFrame>* frames)
+    {
+        m_expected = frames;
+        m_next = 0;
+    }
+
+    const Results& GetResults() const
+    {
+        return m_results;
+    }
+
+protected:
+    void OnFrameReceived(uint32_t time)
+    {
+        m_results.m_frames++;
+        if (m_expected == nullptr)
+            return;
+
+        while (m_next < m_expected->size() && (*m_expected)[m_next].m_time < time)
+        {
+            m_next++;
+        }
+
+        if (m_next < m_expected->size() && (*m_expected)[m_next].m_time == time)
+        {
+            const auto& values = (*m_expected)[m_next++].m_values;
+            bool isMatch = true;
+            for (uint8_t i = 0; i < values.size(); i++)
+            {
+                if (abs(static_cast<int>(static_cast<T*>(this)->GetValue(i)) - values[i]) > 1)
+                {
+                    isMatch = false;
+                }
+            }
+
+            if (isMatch)
+            {
+                m_results.m_matched++;
+            }
+            else
+            {
+                m_results.m_mismatched++;
+            }
+        }
+        else
+        {
+            m_results.m_unexpected++;
+        }
+    }
+
+    void OnError(DecoderError error)
+    {
+        switch (error)
+        {
+        case DecoderError::Checksum:
+            m_results.m_checksumErrors++;
+            break;
+        case DecoderError::ShortFrame:
+            m_results.m_shortFrames++;
+            break;
+        case DecoderError::LongFrame:
+            m_results.m_longFrames++;
+            break;
+        }
+    }
+
+    void OnTimeout()
+    {
+        m_results.m_timeouts++;
+    }
+
+private:
+    Results m_results = {};
+    const std::vector<ExpectedFrame>* m_expected = nullptr;
+    size_t m_next = 0;
+};
+
+class PpmBenchReceiver : public PpmReceiverT<PpmBenchReceiver, PpmTimer>, public BenchReceiverT<PpmBenchReceiver>
+{
+    friend PpmReceiverT;
+    friend BenchReceiverT;
+    using BenchReceiverT::OnFrameReceived;
+    using BenchReceiverT::OnError;
+    using BenchReceiverT::OnTimeout;
+
+    uint16_t GetValue(uint8_t channel)
+    {
+        return GetChannelPulseWidth(channel);
+    }
+};
+
+class PcmBenchReceiver : public PcmReceiverT<PcmBenchReceiver, Timer>, public BenchReceiverT<PcmBenchReceiver>
+{
+    friend PcmReceiverT;
+    friend BenchReceiverT;
+    using BenchReceiverT::OnFrameReceived;
+    using BenchReceiverT::OnError;
+    using BenchReceiverT::OnTimeout;
+
+    uint16_t GetValue(uint8_t channel)
+    {
+        return GetChannelData(channel);
+    }
+};
+
+class SrxlBenchReceiver : public SrxlReceiverT<SrxlBenchReceiver, SrxlTimer, MockUsart>, public BenchReceiverT<SrxlBenchReceiver>
+{
+    friend SrxlReceiverT;
+    friend BenchReceiverT;
+    using BenchReceiverT::OnFrameReceived;
+    using BenchReceiverT::OnError;
+    using BenchReceiverT::OnTimeout;
+
+    uint16_t GetValue(uint8_t channel)
+    {
+        return GetChannelPulseWidth(channel);
+    }
+};
+
+/////////////////////////////////////////////////////////////////////////////
+
+// xorshift32, so the generated traces are the same on every run
+class Random
+{
+public:
+    uint32_t Next()
+    {
+        m_state ^= m_state << 13;
+        m_state ^= m_state >> 17;
+        m_state ^= m_state << 5;
+        return m_state;
+    }
+
+    uint32_t Next(uint32_t count)
+    {
+        return Next() % count;
+    }
+
+    // Uniform in [-range, range]
+    int32_t Jitter(uint32_t range)
+    {
+        return static_cast<int32_t>(Next(2 * range + 1)) - static_cast<int32_t>(range);
+    }
+
+private:
+    uint32_t m_state = 2463534242;
+};
+
+static const uint32_t errorRate = 64; // One frame in errorRate is corrupted
+
+static uint32_t UsToTicks(uint32_t us)
+{
+    return static_cast<uint32_t>(static_cast<uint64_t>(us) * (F_CPU / TIMER1_PRESCALER) / 1000000);
+}
+
+static void AddEvent(Trace& trace, uint32_t time, Event::Type type, uint8_t data = 0)
+{
+    trace.m_events.push_back(Event{ time, type, data });
+}
+
+// PPM: a rising edge starts each channel, another one ends the last channel,
+// followed by a sync pause. Widths are 1000..2000us, with 2 ticks of jitter.
+static Trace GeneratePpmTrace(uint32_t frameCount)
+{
+    static const uint8_t channelCount = 8;
+    static const uint32_t framePeriodUs = 22500;
+
+    Random random;
+    Trace trace;
+    uint32_t frameStart = UsToTicks(10000);
+    for (uint32_t frame = 0; frame < frameCount; frame++)
+    {
+        uint32_t error = random.Next(errorRate);
+        uint8_t pulseCount = error == 0 ? 2 : error == 1 ? 10 : channelCount;
+
+        ExpectedFrame expected;
+        uint32_t time = frameStart;
+        AddEvent(trace, time, Event::RisingEdge);
+        for (uint8_t i = 0; i < pulseCount; i++)
+        {
+            uint32_t width = i < channelCount ? UsToTicks(1000 + random.Next(1001)) : UsToTicks(1000);
+            uint32_t jitter = random.Next(3);
+            time += width + jitter;
+            AddEvent(trace, time, Event::RisingEdge);
+            expected.m_values.push_back(PpmTimer::TicksToUs(static_cast<uint16_t>(width + jitter)));
+        }
+
+        // A long frame is reported with its first 9 channels, and a LongFrame error
+        if (pulseCount > 2)
+        {
+            expected.m_values.resize(std::min<size_t>(expected.m_values.size(), 9));
+            expected.m_time = time;
+            trace.m_frames.push_back(expected);
+        }
+
+        frameStart += UsToTicks(framePeriodUs) + random.Jitter(4);
+    }
+
+    return trace;
+}
+
+// Multiplex PCM: symbols are the time between falling edges, 880..1720us in 140us steps,
+// each rising edge comes 300us after a falling edge, and a low of 1500us is the sync.
+// A frame is 8 channels of 4 bit pairs and a checksum pair, then the frame type 0xC.
+class PcmTraceWriter
+{
+public:
+    explicit PcmTraceWriter(Trace& trace, Random& random) : m_trace(trace), m_random(random)
+    {
+    }
+
+    void WriteSync(uint32_t time)
+    {
+        m_time = time;
+        AddEvent(m_trace, m_time, Event::RisingEdge);
+        m_time += UsToTicks(500);
+        AddEvent(m_trace, m_time, Event::FallingEdge);
+        AddEvent(m_trace, m_time + UsToTicks(300), Event::RisingEdge);
+        m_lastBits = 3;
+    }
+
+    void WriteBits(uint8_t bits)
+    {
+        uint8_t symbol = bits - m_lastBits + 3;
+        m_lastBits = bits;
+        m_time += UsToTicks(880 + symbol * 140) + m_random.Jitter(UsToTicks(20));
+        AddEvent(m_trace, m_time, Event::FallingEdge);
+        AddEvent(m_trace, m_time + UsToTicks(300), Event::RisingEdge);
+    }
+
+    // The time of the last falling edge
+    uint32_t GetTime() const
+    {
+        return m_time;
+    }
+
+private:
+    Trace& m_trace;
+    Random& m_random;
+    uint32_t m_time = 0;
+    uint8_t m_lastBits = 3;
+};
+
+static Trace GeneratePcmTrace(uint32_t frameCount)
+{
+    static const uint8_t channelCount = 8;
+
+    Random random;
+    Trace trace;
+    PcmTraceWriter writer(trace, random);
+    uint32_t time = UsToTicks(10000);
+    for (uint32_t frame = 0; frame < frameCount; frame++)
+    {
+        bool isCorrupted = random.Next(errorRate) == 0;
+        uint8_t corruptedChannel = random.Next(channelCount);
+
+        ExpectedFrame expected;
+        writer.WriteSync(time);
+        for (uint8_t i = 0; i < channelCount; i++)
+        {
+            uint8_t data = random.Next(256);
+            uint8_t checksum = 3;
+            for (int8_t shift = 6; shift >= 0; shift -= 2)
+            {
+                uint8_t bits = (data >> shift) & 3;
+                checksum ^= bits;
+                writer.WriteBits(bits);
+            }
+
+            writer.WriteBits(isCorrupted && i == corruptedChannel ? checksum ^ 1 : checksum);
+            expected.m_values.push_back(static_cast<uint8_t>(~data));
+        }
+
+        writer.WriteBits(3);
+        writer.WriteBits(0);
+
+        if (!isCorrupted)
+        {
+            expected.m_time = writer.GetTime();
+            trace.m_frames.push_back(expected);
+        }
+
+        time = writer.GetTime() + UsToTicks(1500);
+    }
+
+    return trace;
+}
+
+// Multiplex SRXL V2 at 115200 baud: 0xA2, 16 big-endian 12-bit channel values and a CRC-16,
+// one byte every 87us, one frame every 14ms. Corrupted frames have a flipped bit or are cut short.
+static uint16_t UpdateCrc16(uint16_t crc, uint8_t value)
+{
+    crc ^= static_cast<uint16_t>(value) << 8;
+    for (uint8_t i = 0; i < 8; i++)
+    {
+        crc = (crc & 0x8000) != 0 ? (crc << 1) ^ 0x1021 : crc << 1;
+    }
+
+    return crc;
+}
+
+static Trace GenerateSrxlTrace(uint32_t frameCount)
+{
+    static const uint8_t channelCount = 16;
+    static const uint32_t framePeriodUs = 14000;
+    static const uint32_t byteTimeUs = 87;
+
+    Random random;
+    Trace trace;
+    uint32_t frameStart = UsToTicks(10000);
+    for (uint32_t frame = 0; frame < frameCount; frame++)
+    {
+        uint32_t error = random.Next(errorRate);
+
+        ExpectedFrame expected;
+        std::vector<uint8_t> data;
+        data.push_back(0xA2);
+        for (uint8_t i = 0; i < channelCount; i++)
+        {
+            uint16_t value = random.Next(0x1000);
+            data.push_back(static_cast<uint8_t>(value >> 8));
+            data.push_back(static_cast<uint8_t>(value));
+            expected.m_values.push_back(800 + static_cast<uint16_t>((static_cast<uint32_t>(value) * 1400 + 0x800) / 0x1000));
+        }
+
+        uint16_t crc = 0;
+        for (auto value : data)
+        {
+            crc = UpdateCrc16(crc, value);
+        }
+
+        data.push_back(static_cast<uint8_t>(crc >> 8));
+        data.push_back(static_cast<uint8_t>(crc));
+
+        if (error == 0)
+        {
+            data[1 + random.Next(channelCount * 2)] ^= 0x10;
+        }
+        else if (error == 1)
+        {
+            data.resize(data.size() / 2);
+        }
+
+        uint32_t time = frameStart;
+        for (auto value : data)
+        {
+            AddEvent(trace, time, Event::Data, value);
+            time += UsToTicks(byteTimeUs);
+        }
+
+        if (error > 1)
+        {
+            expected.m_time = time - UsToTicks(byteTimeUs);
+            trace.m_frames.push_back(expected);
+        }
+
+        frameStart += UsToTicks(framePeriodUs) + random.Jitter(4);
+    }
+
+    return trace;
+}
+
+// A recorded trace in the event file format of the host build, see the README.
+// Only the high, low and byte commands are used.
+static bool ReadTrace(const char* path, Trace& trace)
+{
+    FILE* file = fopen(path, "r");
+    if (file == nullptr)
+        return false;
+
+    char line[256];
+    while (fgets(line, sizeof(line), file) != nullptr)
+    {
+        double us;
+        char command[16];
+        unsigned int value = 0;
+        int fields = sscanf(line, "%lf %15s %i", &us, command, &value);
+        if (fields < 2)
+            continue;
+
+        uint32_t time = static_cast<uint32_t>(us * (F_CPU / TIMER1_PRESCALER) / 1000000 + 0.5);
+        if (strcmp(command, "high") == 0 || strcmp(command, "low") == 0)
+        {
+            AddEvent(trace, time, command[0] == 'h' ? Event::RisingEdge : Event::FallingEdge);
+        }
+        else if (strcmp(command, "byte") == 0 && fields == 3)
+        {
+            AddEvent(trace, time, Event::Data, static_cast<uint8_t>(value));
+        }
+    }
+
+    fclose(file);
+    trace.m_isRecorded = true;
+    return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+// Raises the output compare for every match of the compare register
+// between the last event and 'time', as Timer1 would.
+template<typename TimerPolicy, typename Receiver>
+static void RunOutputCompare(Receiver& receiver, uint32_t& lastTime, uint32_t time)
+{
+    for (;;)
+    {
+        uint16_t delta = TimerPolicy::OCR() - static_cast<uint16_t>(lastTime);
+        uint32_t match = lastTime + (delta != 0 ? delta : 0x10000);
+        if (match >= time)
+            break;
+
+        TimerPolicy::TCNT() = static_cast<uint16_t>(match);
+        receiver.OnOutputCompare();
+        lastTime = match;
+    }
+
+    TimerPolicy::TCNT() = static_cast<uint16_t>(time);
+    lastTime = time;
+}
+
+static const uint32_t idleTicks = 0x10000;
+
+template<typename Receiver>
+static void RunTask(Receiver& receiver, uint32_t time, uint16_t& milliseconds)
+{
+    auto now = static_cast<uint16_t>(Timer::TicksToUs32(time) / 1000);
+    if (now != milliseconds)
+    {
+        milliseconds = now;
+        receiver.RunTask(now);
+    }
+}
+
+static void Replay(PpmBenchReceiver& receiver, const Trace& trace)
+{
+    uint32_t lastTime = 0;
+    for (const auto& event : trace.m_events)
+    {
+        RunOutputCompare<PpmTimer>(receiver, lastTime, event.m_time);
+        if (event.m_type == Event::RisingEdge)
+        {
+            receiver.OnInputEdge(event.m_time);
+        }
+    }
+
+    // The sync pause after the last frame
+    RunOutputCompare<PpmTimer>(receiver, lastTime, lastTime + idleTicks);
+}
+
+static void Replay(PcmBenchReceiver& receiver, const Trace& trace)
+{
+    uint16_t milliseconds = 0;
+
+    // The main loop runs the task from power-up, before the first event
+    receiver.RunTask(milliseconds);
+
+    for (const auto& event : trace.m_events)
+    {
+        RunTask(receiver, event.m_time, milliseconds);
+        if (event.m_type != Event::Data)
+        {
+            receiver.OnInputEdge(event.m_time, event.m_type == Event::RisingEdge);
+        }
+    }
+}
+
+static void Replay(SrxlBenchReceiver& receiver, const Trace& trace)
+{
+    uint32_t lastTime = 0;
+    uint16_t milliseconds = 0;
+
+    // The main loop runs the task from power-up, before the first event
+    receiver.RunTask(milliseconds);
+
+    for (const auto& event : trace.m_events)
+    {
+        RunOutputCompare<SrxlTimer>(receiver, lastTime, event.m_time);
+        RunTask(receiver, event.m_time, milliseconds);
+        if (event.m_type == Event::Data)
+        {
+            receiver.OnDataReceived(event.m_data, event.m_time);
+        }
+    }
+
+    RunOutputCompare<SrxlTimer>(receiver, lastTime, lastTime + idleTicks);
+}
+
+// Replays the trace 'repeat' times with a fresh decoder and reports the results of the first pass
+template<typename Receiver>
+static void RunBench(const char* name, const Trace& trace, uint32_t repeat)
+{
+    Results results = {};
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < repeat; i++)
+    {
+        Receiver receiver;
+        receiver.Initialize();
+        receiver.SetExpectedFrames(trace.m_isRecorded ? nullptr : &trace.m_frames);
+        Replay(receiver, trace);
+        if (i == 0)
+        {
+            results = receiver.GetResults();
+        }
+    }
+
+    std::chrono::duration<double> seconds = std::chrono::steady_clock::now() - start;
+    double eventsPerSecond = trace.m_events.size() * static_cast<double>(repeat) / seconds.count();
+
+    printf("%-6s %9zu %8u", name, trace.m_events.size(), results.m_frames);
+    if (trace.m_isRecorded)
+    {
+        printf(" %8s %8s %8s %8s", "-", "-", "-", "-");
+    }
+    else
+    {
+        printf(" %8zu %8u %8u %8zu", trace.m_frames.size(), results.m_matched, results.m_mismatched + results.m_unexpected,
+            trace.m_frames.size() - results.m_matched - results.m_mismatched);
+    }
+
+    printf(" %8u %8u %8u %8u %10.2f\n",
+        results.m_checksumErrors, results.m_shortFrames, results.m_longFrames, results.m_timeouts, eventsPerSecond / 1e6);
+}
+
+// The comparison tree that classified PCM symbols before PcmSymbolTableT
+template<typename timer>
+static uint8_t GetSymbolTree(uint16_t width)
+{
+    static const uint16_t S0 = 880;
+    static const uint16_t S1 = 1020;
+    static const uint16_t S2 = 1160;
+    static const uint16_t S3 = 1300;
+    static const uint16_t S4 = 1440;
+    static const uint16_t S5 = 1580;
+    static const uint16_t S6 = 1720;
+    static const uint16_t W = 140 / 2;
+
+    if (width < timer::UsToTicks(S3 - W))
+    {
+        if (width < timer::UsToTicks(S1 - W))
+        {
+            return width < timer::UsToTicks(S0 - W) ? 7 : 0;
+        }
+        else
+        {
+            return width < timer::UsToTicks(S2 - W) ? 1 : 2;
+        }
+    }
+    else
+    {
+        if (width < timer::UsToTicks(S5 - W))
+        {
+            return width < timer::UsToTicks(S4 - W) ? 3 : 4;
+        }
+        else
+        {
+            return width < timer::UsToTicks(S6 - W) ? 5 : 6;
+        }
+    }
+}
+
+// Returns the time per symbol, and the sum of the symbols, which the caller prints,
+// so the loop cannot be optimized away.
+template<uint8_t (*getSymbol)(uint16_t)>
+static double MeasureSymbols(const std::vector<uint16_t>& widths, uint32_t repeat, uint32_t& sum)
+{
+    sum = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < repeat; i++)
+    {
+        for (auto width : widths)
+        {
+            sum += getSymbol(width);
+        }
+    }
+
+    std::chrono::duration<double> seconds = std::chrono::steady_clock::now() - start;
+    return seconds.count() * 1e9 / (static_cast<double>(widths.size()) * repeat);
+}
+
+// Checks that the table classifies every width like the tree,
+// and times both on the symbol widths of the PCM trace.
+static void RunPcmSymbolBench(const Trace& trace, uint32_t repeat)
+{
+    using SymbolTable = PcmSymbolTableT<Timer>;
+
+    uint32_t differences = 0;
+    for (uint32_t width = 0; width <= 0xFFFF; width++)
+    {
+        if (SymbolTable::GetSymbol(static_cast<uint16_t>(width)) != GetSymbolTree<Timer>(static_cast<uint16_t>(width)))
+        {
+            differences++;
+        }
+    }
+
+    std::vector<uint16_t> widths;
+    uint32_t lastTime = 0;
+    for (const auto& event : trace.m_events)
+    {
+        if (event.m_type == Event::FallingEdge)
+        {
+            uint32_t elapsed = event.m_time - lastTime;
+            widths.push_back(elapsed <= 0xFFFF ? static_cast<uint16_t>(elapsed) : 0xFFFF);
+            lastTime = event.m_time;
+        }
+    }
+
+    if (widths.empty())
+        return;
+
+    uint32_t treeSum;
+    uint32_t tableSum;
+    double treeNs = MeasureSymbols<&GetSymbolTree<Timer>>(widths, repeat, treeSum);
+    double tableNs = MeasureSymbols<&SymbolTable::GetSymbol>(widths, repeat, tableSum);
+    printf("PCM symbols: %u of 65536 widths classified differently, %zu symbols, tree %.2f ns, table %.2f ns per symbol, symbol sums %u and %u\n",
+        differences, widths.size(), treeNs, tableNs, treeSum, tableSum);
+}
+
+static void PrintUsage()
+{
+    fprintf(stderr,
+        "Usage: decoder_bench [--frames N] [--repeat N] [--ppm FILE] [--pcm FILE] [--srxl FILE]\n"
+        "Without trace files, generated traces of N frames per decoder are replayed.\n");
+}
+
+int main(int argc, char* argv[])
+{
+    uint32_t frameCount = 20000;
+    uint32_t repeat = 10;
+    const char* ppmPath = nullptr;
+    const char* pcmPath = nullptr;
+    const char* srxlPath = nullptr;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (i + 1 < argc && strcmp(argv[i], "--frames") == 0)
+        {
+            frameCount = strtoul(argv[++i], nullptr, 0);
+        }
+        else if (i + 1 < argc && strcmp(argv[i], "--repeat") == 0)
+        {
+            repeat = strtoul(argv[++i], nullptr, 0);
+        }
+        else if (i + 1 < argc && strcmp(argv[i], "--ppm") == 0)
+        {
+            ppmPath = argv[++i];
+        }
+        else if (i + 1 < argc && strcmp(argv[i], "--pcm") == 0)
+        {
+            pcmPath = argv[++i];
+        }
+        else if (i + 1 < argc && strcmp(argv[i], "--srxl") == 0)
+        {
+            srxlPath = argv[++i];
+        }
+        else
+        {
+            PrintUsage();
+            return 1;
+        }
+    }
+
+    if (repeat == 0)
+    {
+        repeat = 1;
+    }
+
+    bool isRecorded = ppmPath != nullptr || pcmPath != nullptr || srxlPath != nullptr;
+    Trace ppmTrace;
+    Trace pcmTrace;
+    Trace srxlTrace;
+    if (isRecorded)
+    {
+        if ((ppmPath != nullptr && !ReadTrace(ppmPath, ppmTrace)) ||
+            (pcmPath != nullptr && !ReadTrace(pcmPath, pcmTrace)) ||
+            (srxlPath != nullptr && !ReadTrace(srxlPath, srxlTrace)))
+        {
+            fprintf(stderr, "Cannot read the trace file\n");
+            return 1;
+        }
+    }
+    else
+    {
+        ppmTrace = GeneratePpmTrace(frameCount);
+        pcmTrace = GeneratePcmTrace(frameCount);
+        srxlTrace = GenerateSrxlTrace(frameCount);
+    }
+
+    printf("F_CPU %u, Timer1 clk/%u, %u passes\n", static_cast<unsigned>(F_CPU), TIMER1_PRESCALER, repeat);
+    printf("%-6s %9s %8s %8s %8s %8s %8s %8s %8s %8s %8s %10s\n",
+        "", "Events", "Frames", "Sent", "Matched", "Wrong", "Lost", "Checksum", "Short", "Long", "Timeouts", "Mevents/s");
+
+    if (!ppmTrace.m_events.empty())
+    {
+        RunBench<PpmBenchReceiver>("PPM", ppmTrace, repeat);
+    }
+
+    if (!pcmTrace.m_events.empty())
+    {
+        RunBench<PcmBenchReceiver>("PCM", pcmTrace, repeat);
+    }
+
+    if (!srxlTrace.m_events.empty())
+    {
+        RunBench<SrxlBenchReceiver>("SRXL", srxlTrace, repeat);
+    }
+
+    RunPcmSymbolBench(pcmTrace, repeat);
+
+    return 0;
+}
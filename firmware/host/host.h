@@ -0,0 +1,248 @@
+//
+// host.h
+// Copyright (C) 2018 Marius Greuel
+// SPDX-License-Identifier: GPL-3.0-or-later
+//
+
+// The parts of the virtual ATmega32U4 that runs the firmware as a host process:
+// the clock and interrupts in host_platform.cpp, the USB device controller and
+// the USB host in host_usb.cpp, and the event input and client socket in
+// host_transport.cpp.
+
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <deque>
+#include <functional>
+#include <string>
+#include <vector>
+#include <host_platform.h>
+
+using Packet = std::vector<uint8_t>;
+using Vector = void (*)();
+
+class Mcu
+{
+public:
+    static uint64_t GetCycles();
+    static uint64_t GetNanoseconds();
+
+    // Runs an interrupt handler, with the I flag cleared while it runs.
+    static void RaiseInterrupt(Vector vector);
+
+    [[noreturn]] static void Fail(const char* format, ...) __attribute__((format(printf, 1, 2)));
+};
+
+/////////////////////////////////////////////////////////////////////////////
+
+// The USB device controller, and a host that enumerates the device,
+// polls its IN endpoints once per frame, and runs control transfers.
+class UsbModel
+{
+public:
+    static const uint8_t endpointCount = 7;
+
+    enum class Status : uint8_t
+    {
+        Ack,
+        Stall,
+        NoHandshake,
+    };
+
+    struct Setup
+    {
+        uint8_t m_data[8];
+
+        uint8_t GetRequestType() const { return m_data[0]; }
+        uint16_t GetLength() const { return static_cast<uint16_t>(m_data[6] | (m_data[7] << 8)); }
+        bool IsDeviceToHost() const { return (m_data[0] & 0x80) != 0; }
+    };
+
+    struct EndpointStatistics
+    {
+        uint32_t m_packets;
+        uint64_t m_bytes;
+    };
+
+    // The register accesses of the firmware, by what it was doing at the time:
+    // a control transfer, the packets of an endpoint, or the USB_GEN interrupt.
+    struct AccessStatistics
+    {
+        std::string m_name;
+        uint32_t m_transfers = 0;
+        uint64_t m_bytes = 0;
+        uint64_t m_reads = 0;
+        uint64_t m_writes = 0;
+        uint64_t m_polls = 0;
+    };
+
+    using PacketHandler = std::function<void(uint8_t endpoint, const Packet& packet)>;
+
+public:
+    void SetPacketHandler(PacketHandler handler) { m_packetHandler = handler; }
+
+    bool IsAttached() const;
+    bool IsConnected() const { return m_isConnected; }
+
+    // Resets the bus and enumerates the device. Opening the CDC port sets DTR,
+    // so the firmware starts to send text.
+    void Connect(bool openCdcPort);
+
+    // Raises the start-of-frame interrupt, then polls the IN endpoints.
+    void OnStartOfFrame();
+
+    // The firmware waits on the USB registers only within a main loop pass.
+    void OnMainLoopPass() { m_spinCount = 0; }
+
+    Status ControlTransfer(const Setup& setup, const Packet& out, Packet& in);
+    void SendOut(uint8_t endpoint, const Packet& data);
+
+    const char* GetEndpointName(uint8_t endpoint) const;
+    const EndpointStatistics& GetStatistics(uint8_t endpoint) const { return m_endpoints[endpoint].m_statistics; }
+    uint32_t GetControlTransfers() const { return m_controlTransfers; }
+    uint32_t GetStalledTransfers() const { return m_stalledTransfers; }
+    void PrintAccessStatistics(FILE* file) const;
+
+    uint8_t ReadRegister(uint8_t reg);
+    void WriteRegister(uint8_t reg, uint8_t value);
+
+private:
+    struct Endpoint
+    {
+        uint8_t m_uecfg0x = 0;
+        uint8_t m_uecfg1x = 0;
+        uint8_t m_ueconx = 0;
+        uint8_t m_ueienx = 0;
+
+        // The bank the firmware reads or writes through UEDATX
+        std::deque<uint8_t> m_fifo;
+
+        // IN: the banks waiting for the host. OUT: the packets waiting for a free bank.
+        std::deque<Packet> m_packets;
+
+        bool m_setupReceived = false;
+        bool m_outReceived = false;
+        uint16_t m_outSize = 0;
+
+        // From the descriptors, read during enumeration
+        uint8_t m_interval = 1;
+        const char* m_name = nullptr;
+
+        EndpointStatistics m_statistics = {};
+        AccessStatistics* m_access = nullptr;
+
+        bool IsAllocated() const;
+        bool IsControl() const;
+        bool IsIn() const;
+        bool IsInterrupt() const;
+        uint16_t GetSize() const;
+        uint8_t GetBanks() const;
+        bool IsBankFree() const;
+        void Reset();
+    };
+
+    Endpoint& GetSelectedEndpoint();
+    uint8_t ReadUeintx(Endpoint& endpoint);
+    void WriteUeintx(Endpoint& endpoint, uint8_t value);
+    void SendControlIn(Endpoint& endpoint);
+    void LoadOutPacket(Endpoint& endpoint);
+    Status Request(uint8_t requestType, uint8_t request, uint16_t value, uint16_t index, uint16_t length, Packet& in);
+    void ParseConfigurationDescriptor(const Packet& descriptor);
+    void RaiseGeneralInterrupt(uint8_t flag, uint8_t enable);
+    void CountAccess(uint8_t reg, bool isWrite);
+    AccessStatistics& GetEndpointAccess(uint8_t index);
+    AccessStatistics& GetAccessStatistics(const std::string& name);
+    std::string GetRequestName(const Setup& setup) const;
+
+private:
+    Endpoint m_endpoints[endpointCount];
+    uint8_t m_pllcsr = 0;
+    uint8_t m_udint = 0;
+    uint8_t m_uenum = 0;
+    bool m_isConnected = false;
+    uint8_t m_cdcInterface = 0;
+    uint16_t m_frameNumber = 0;
+    uint32_t m_spinCount = 0;
+    PacketHandler m_packetHandler;
+
+    // The control transfer in progress
+    bool m_isControlInProgress = false;
+    bool m_isControlComplete = false;
+    bool m_isControlDataComplete = false;
+    Setup m_setup = {};
+    std::deque<Packet> m_controlOut;
+    Packet m_controlIn;
+
+    uint32_t m_controlTransfers = 0;
+    uint32_t m_stalledTransfers = 0;
+
+    // A deque, so the endpoints can keep pointers to their entries
+    std::deque<AccessStatistics> m_accessStatistics;
+    AccessStatistics* m_controlAccess = nullptr;
+    bool m_isGeneralInterrupt = false;
+    bool m_isEndpointSelected = false;
+    uint64_t m_registerReads[HostPlatform::RegisterCount] = {};
+    uint64_t m_registerWrites[HostPlatform::RegisterCount] = {};
+};
+
+/////////////////////////////////////////////////////////////////////////////
+
+struct InputEvent
+{
+    enum class Type : uint8_t
+    {
+        Level,
+        Data,
+        Request,
+        Out,
+    };
+
+    uint64_t m_time; // ns
+    Type m_type;
+    uint8_t m_value; // The level, the data byte, or the OUT endpoint
+    Packet m_payload; // The SETUP packet followed by the OUT data, or the OUT data
+};
+
+// Reads the input events from a text file, or from a client on a Unix socket,
+// which also gets the packets the host reads from the device. USB requests and
+// OUT data are events as well, so they run after the events before them.
+// See the README for both formats.
+class Transport
+{
+public:
+    bool OpenFile(const char* path);
+    bool OpenSocket(const char* path);
+    bool HasClient() const { return m_socket >= 0; }
+
+    // All events up to the horizon are known, unless the input has ended.
+    uint64_t GetHorizon() const { return m_horizon; }
+    bool IsEnd() const { return m_isEnd; }
+
+    // Reads the next line or message, waits for the client if needed.
+    void ReadNext();
+
+    bool HasEvent() const { return !m_events.empty(); }
+    const InputEvent& PeekEvent() const { return m_events.front(); }
+    void PopEvent() { m_events.pop_front(); }
+
+    void SendInPacket(uint64_t time, uint8_t endpoint, const Packet& packet);
+    void SendRequestStatus(uint8_t status, const Packet& data);
+
+private:
+    bool ReadLine();
+    bool ReadMessage();
+    bool ReadExactly(void* buffer, size_t size);
+    void WriteMessage(uint8_t type, uint8_t endpoint, const Packet& payload);
+    void AddPpmFrames(uint64_t time, uint32_t frames, uint32_t period, const std::vector<uint32_t>& widths);
+    void AddEvent(InputEvent& event);
+    void SetHorizon(uint64_t time);
+
+private:
+    FILE* m_file = nullptr;
+    int m_socket = -1;
+    uint32_t m_line = 0;
+    uint64_t m_horizon = 0;
+    bool m_isEnd = false;
+    std::deque<InputEvent> m_events;
+};
@@ -0,0 +1,729 @@
+//
+// host_platform.cpp
+// Copyright (C) 2018 Marius Greuel
+// SPDX-License-Identifier: GPL-3.0-or-later
+//
+
+// The clock, the timers, the pins and the interrupts of the virtual ATmega32U4.
+// The firmware runs unmodified in its own main(). Each time the main loop resets
+// the watchdog, the platform advances the virtual time by one loop pass and runs
+// the interrupts that came due in between, in the order they came due.
+
+#define _GNU_SOURCE 1
+#include <errno.h>
+#include <getopt.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "host.h"
+#include <avr/io.h>
+
+volatile uint8_t SREG;
+volatile uint8_t MCUSR;
+volatile uint8_t GPIOR0;
+volatile uint8_t GPIOR1;
+volatile uint8_t GPIOR2;
+// Input pins with pull-ups read high while nothing drives them
+volatile uint8_t PINB = 0xFF;
+volatile uint8_t DDRB;
+volatile uint8_t PORTB;
+volatile uint8_t PINC = 0xFF;
+volatile uint8_t DDRC;
+volatile uint8_t PORTC;
+volatile uint8_t PIND = 0xFF;
+volatile uint8_t DDRD;
+volatile uint8_t PORTD;
+volatile uint8_t PINF = 0xFF;
+volatile uint8_t DDRF;
+volatile uint8_t PORTF;
+volatile uint8_t PCICR;
+volatile uint8_t PCIFR;
+volatile uint8_t PCMSK0;
+volatile uint8_t ACSR;
+volatile uint8_t ADCSRA;
+volatile uint8_t ADCSRB;
+volatile uint8_t ADMUX;
+volatile uint8_t TCCR0A;
+volatile uint8_t TCCR0B;
+volatile uint8_t TCCR1A;
+volatile uint8_t TCCR1B;
+volatile uint8_t TIMSK1;
+volatile uint16_t TCNT1;
+volatile uint16_t ICR1;
+volatile uint16_t OCR1B;
+volatile uint16_t OCR1C;
+volatile uint8_t TCCR3A;
+volatile uint8_t TCCR3B;
+volatile uint8_t TIMSK3;
+volatile uint16_t TCNT3;
+volatile uint8_t UCSR1A;
+volatile uint8_t UCSR1B;
+volatile uint8_t UCSR1C;
+volatile uint16_t UBRR1;
+volatile uint8_t UDR1;
+volatile uint8_t UHWCON;
+volatile uint8_t USBCON;
+volatile uint8_t UDCON;
+volatile uint8_t UDIEN;
+volatile uint8_t UDADDR;
+volatile uint16_t UDFNUM;
+
+// The vectors the firmware does not implement, like the empty avr-libc default
+extern "C" __attribute__((weak)) void PCINT0_vect() {}
+extern "C" __attribute__((weak)) void USB_GEN_vect() {}
+extern "C" __attribute__((weak)) void USB_COM_vect() {}
+extern "C" __attribute__((weak)) void TIMER1_CAPT_vect() {}
+extern "C" __attribute__((weak)) void TIMER1_COMPB_vect() {}
+extern "C" __attribute__((weak)) void TIMER1_COMPC_vect() {}
+extern "C" __attribute__((weak)) void TIMER1_OVF_vect() {}
+extern "C" __attribute__((weak)) void USART1_RX_vect() {}
+extern "C" __attribute__((weak)) void TIMER3_OVF_vect() {}
+
+static const uint64_t cyclesPerUs = F_CPU / 1000000;
+static const uint64_t cyclesPerFrame = F_CPU / 1000;
+
+/////////////////////////////////////////////////////////////////////////////
+
+namespace
+{
+    struct VectorInfo
+    {
+        Vector m_vector;
+        const char* m_name;
+        uint64_t m_count;
+    };
+
+    // In the order of the AVR vector table
+    VectorInfo g_vectors[] =
+    {
+        { PCINT0_vect, "PCINT0", 0 },
+        { USB_GEN_vect, "USB_GEN", 0 },
+        { USB_COM_vect, "USB_COM", 0 },
+        { TIMER1_CAPT_vect, "TIMER1_CAPT", 0 },
+        { TIMER1_COMPB_vect, "TIMER1_COMPB", 0 },
+        { TIMER1_COMPC_vect, "TIMER1_COMPC", 0 },
+        { TIMER1_OVF_vect, "TIMER1_OVF", 0 },
+        { USART1_RX_vect, "USART1_RX", 0 },
+        { TIMER3_OVF_vect, "TIMER3_OVF", 0 },
+    };
+
+    struct Options
+    {
+        const char* m_input = "-";
+        const char* m_socket = nullptr;
+        uint64_t m_loopCycles = 10 * cyclesPerUs;
+        bool m_cdc = false;
+        bool m_trace = false;
+        bool m_usbStatistics = false;
+    };
+
+    struct Statistics
+    {
+        uint64_t m_passes;
+        uint32_t m_edges;
+        uint32_t m_bytes;
+        uint32_t m_requests;
+    };
+
+    Options g_options;
+    Statistics g_statistics;
+    UsbModel g_usb;
+    Transport g_transport;
+    FILE* g_console;
+    FILE* g_error;
+    uint64_t g_cycles;
+    uint64_t g_nextFrame;
+    bool g_isStarted;
+    int g_argc;
+    char** g_argv;
+    bool g_level = true;
+    timespec g_startTime;
+    void (*g_putchar)(char ch);
+    char (*g_getchar)();
+
+    // The prescaler from the clock select bits, or 0 if the timer is stopped
+    uint16_t GetPrescaler(uint8_t tccrb)
+    {
+        switch (tccrb & 7)
+        {
+        case 1:
+            return 1;
+        case 2:
+            return 8;
+        case 3:
+            return 64;
+        case 4:
+            return 256;
+        case 5:
+            return 1024;
+        default:
+            return 0;
+        }
+    }
+
+    // The first cycle after 'after' in which the 16-bit counter equals 'value'
+    uint64_t GetCompareCycle(uint8_t tccrb, uint16_t value, uint64_t after)
+    {
+        uint16_t prescaler = GetPrescaler(tccrb);
+        if (prescaler == 0)
+            return UINT64_MAX;
+
+        uint64_t ticks = after / prescaler;
+        uint16_t delta = static_cast<uint16_t>(value - static_cast<uint16_t>(ticks));
+        return (ticks + (delta != 0 ? delta : 0x10000)) * prescaler;
+    }
+
+    // The first cycle after 'after' in which the 16-bit counter wraps
+    uint64_t GetOverflowCycle(uint8_t tccrb, uint64_t after)
+    {
+        uint16_t prescaler = GetPrescaler(tccrb);
+        if (prescaler == 0)
+            return UINT64_MAX;
+
+        return (((after / prescaler) >> 16) + 1) * 0x10000 * prescaler;
+    }
+
+    uint64_t ToNanoseconds(uint64_t cycles)
+    {
+        return cycles * 1000 / cyclesPerUs;
+    }
+
+    uint64_t ToCycles(uint64_t ns)
+    {
+        return (ns * cyclesPerUs + 999) / 1000;
+    }
+
+    void Advance(uint64_t cycles)
+    {
+        g_cycles = cycles;
+
+        uint16_t prescaler1 = GetPrescaler(TCCR1B);
+        if (prescaler1 != 0)
+        {
+            TCNT1 = static_cast<uint16_t>(g_cycles / prescaler1);
+        }
+
+        uint16_t prescaler3 = GetPrescaler(TCCR3B);
+        if (prescaler3 != 0)
+        {
+            TCNT3 = static_cast<uint16_t>(g_cycles / prescaler3);
+        }
+    }
+
+    void PrintHex(const Packet& data)
+    {
+        for (auto byte : data)
+        {
+            fprintf(g_console, " %02X", byte);
+        }
+    }
+
+    [[noreturn]] void Finish()
+    {
+        timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        double wallTime = (now.tv_sec - g_startTime.tv_sec) + (now.tv_nsec - g_startTime.tv_nsec) * 1e-9;
+        double virtualTime = g_cycles / static_cast<double>(F_CPU);
+
+        FILE* out = g_console;
+        fprintf(out, "\nVirtual time: %.3f s, wall time: %.3f s, %.1fx real time\n",
+            virtualTime, wallTime, wallTime > 0 ? virtualTime / wallTime : 0);
+        fprintf(out, "Main loop passes: %llu\n", static_cast<unsigned long long>(g_statistics.m_passes));
+        fprintf(out, "Input: %u edges, %u bytes, %u requests\n",
+            g_statistics.m_edges, g_statistics.m_bytes, g_statistics.m_requests);
+
+        fprintf(out, "Interrupts:\n");
+        for (const auto& info : g_vectors)
+        {
+            fprintf(out, "  %-14s %llu\n", info.m_name, static_cast<unsigned long long>(info.m_count));
+        }
+
+        fprintf(out, "USB control transfers: %u, stalled: %u\n", g_usb.GetControlTransfers(), g_usb.GetStalledTransfers());
+        for (uint8_t i = 1; i < UsbModel::endpointCount; i++)
+        {
+            const auto& statistics = g_usb.GetStatistics(i);
+            if (statistics.m_packets > 0)
+            {
+                fprintf(out, "  EP%u %-18s %u packets, %llu bytes\n", i, g_usb.GetEndpointName(i),
+                    statistics.m_packets, static_cast<unsigned long long>(statistics.m_bytes));
+            }
+        }
+
+        if (g_options.m_usbStatistics)
+        {
+            g_usb.PrintAccessStatistics(out);
+        }
+
+        fflush(out);
+        exit(0);
+    }
+
+    void OnPacket(uint8_t endpoint, const Packet& packet)
+    {
+        uint64_t time = ToNanoseconds(g_cycles);
+        g_transport.SendInPacket(time, endpoint, packet);
+
+        if (g_options.m_cdc && strcmp(g_usb.GetEndpointName(endpoint), "CDC data in") == 0)
+        {
+            fwrite(packet.data(), 1, packet.size(), g_console);
+        }
+
+        if (g_options.m_trace)
+        {
+            fprintf(g_console, "%.3f us: EP%u", time / 1000.0, endpoint);
+            PrintHex(packet);
+            fprintf(g_console, "\n");
+        }
+    }
+
+    void OnLevel(bool level)
+    {
+        if (level == g_level)
+            return;
+
+        g_level = level;
+        g_statistics.m_edges++;
+
+        // The signal is wired to ICP1 (PD4), to A0 (PF7) for the analog comparator, and to PCINT3 (PB3)
+        PIND = level ? PIND | _BV(PD4) : PIND & ~_BV(PD4);
+        PINF = level ? PINF | _BV(PF7) : PINF & ~_BV(PF7);
+        PINB = level ? PINB | _BV(PB3) : PINB & ~_BV(PB3);
+
+        // The comparator output is high when A0 is below the bandgap reference
+        bool captureLevel = (ACSR & _BV(ACIC)) != 0 ? !level : level;
+        if ((TIMSK1 & _BV(ICIE1)) != 0 && captureLevel == ((TCCR1B & _BV(ICES1)) != 0))
+        {
+            ICR1 = TCNT1;
+            Mcu::RaiseInterrupt(TIMER1_CAPT_vect);
+        }
+
+        if ((PCICR & _BV(PCIE0)) != 0 && (PCMSK0 & _BV(PCINT3)) != 0)
+        {
+            Mcu::RaiseInterrupt(PCINT0_vect);
+        }
+    }
+
+    void OnData(uint8_t data)
+    {
+        g_statistics.m_bytes++;
+        if ((UCSR1B & _BV(RXEN1)) == 0)
+            return;
+
+        UDR1 = data;
+        UCSR1A |= _BV(RXC1);
+        if ((UCSR1B & _BV(RXCIE1)) != 0)
+        {
+            Mcu::RaiseInterrupt(USART1_RX_vect);
+        }
+    }
+
+    void OnRequest(const Packet& payload)
+    {
+        g_statistics.m_requests++;
+
+        UsbModel::Setup setup;
+        memcpy(setup.m_data, payload.data(), sizeof(setup.m_data));
+        Packet out(payload.begin() + sizeof(setup.m_data), payload.end());
+        Packet in;
+        auto status = g_usb.ControlTransfer(setup, out, in);
+        g_transport.SendRequestStatus(static_cast<uint8_t>(status), in);
+
+        if (!g_transport.HasClient())
+        {
+            static const char* const statusNames[] = { "ACK", "STALL", "no handshake" };
+            fprintf(g_console, "%.3f us: Request", ToNanoseconds(g_cycles) / 1000.0);
+            PrintHex(payload);
+            fprintf(g_console, ": %s", statusNames[static_cast<uint8_t>(status)]);
+            PrintHex(in);
+            fprintf(g_console, "\n");
+        }
+    }
+
+    void OnInputEvent(const InputEvent& event)
+    {
+        switch (event.m_type)
+        {
+        case InputEvent::Type::Level:
+            OnLevel(event.m_value != 0);
+            break;
+        case InputEvent::Type::Data:
+            OnData(event.m_value);
+            break;
+        case InputEvent::Type::Request:
+            OnRequest(event.m_payload);
+            break;
+        case InputEvent::Type::Out:
+            g_usb.SendOut(event.m_value, event.m_payload);
+            break;
+        }
+    }
+
+    // Runs the events up to 'limit' in the order they come due
+    void RunEvents(uint64_t limit)
+    {
+        for (;;)
+        {
+            // The next event, on a tie in this order. The Timer1 overflow comes first, so
+            // an edge captured at the wrap sees the extended count, as with TOV1 on the MCU.
+            enum class Source { None, Overflow1, Input, Frame, CompareB, CompareC, Overflow3, Count } source = Source::None;
+            uint64_t next = UINT64_MAX;
+
+            // A timer event that is due in this cycle is still pending, unless it has been raised already.
+            // A handler that does not move the compare register must not match again right away.
+            static uint64_t raised[static_cast<size_t>(Source::Count)];
+            auto after = [&](Source candidate)
+            {
+                uint64_t cycle = g_cycles > 0 ? g_cycles - 1 : 0;
+                return raised[static_cast<size_t>(candidate)] > cycle ? raised[static_cast<size_t>(candidate)] : cycle;
+            };
+
+            auto consider = [&](Source candidate, uint64_t cycle)
+            {
+                if (cycle < next)
+                {
+                    next = cycle;
+                    source = candidate;
+                }
+            };
+
+            if ((TIMSK1 & _BV(TOIE1)) != 0)
+            {
+                consider(Source::Overflow1, GetOverflowCycle(TCCR1B, after(Source::Overflow1)));
+            }
+
+            if (g_transport.HasEvent())
+            {
+                consider(Source::Input, ToCycles(g_transport.PeekEvent().m_time));
+            }
+
+            if (g_usb.IsConnected())
+            {
+                consider(Source::Frame, g_nextFrame);
+            }
+
+            if ((TIMSK1 & _BV(OCIE1B)) != 0)
+            {
+                consider(Source::CompareB, GetCompareCycle(TCCR1B, OCR1B, after(Source::CompareB)));
+            }
+
+            if ((TIMSK1 & _BV(OCIE1C)) != 0)
+            {
+                consider(Source::CompareC, GetCompareCycle(TCCR1B, OCR1C, after(Source::CompareC)));
+            }
+
+            if ((TIMSK3 & _BV(TOIE3)) != 0)
+            {
+                consider(Source::Overflow3, GetOverflowCycle(TCCR3B, after(Source::Overflow3)));
+            }
+
+            if (source == Source::None || next > limit)
+                break;
+
+            Advance(next > g_cycles ? next : g_cycles);
+            raised[static_cast<size_t>(source)] = g_cycles;
+            switch (source)
+            {
+            case Source::Input:
+            {
+                InputEvent event = g_transport.PeekEvent();
+                g_transport.PopEvent();
+                OnInputEvent(event);
+                break;
+            }
+            case Source::Frame:
+                g_nextFrame += cyclesPerFrame;
+                g_usb.OnStartOfFrame();
+                break;
+            case Source::CompareB:
+                Mcu::RaiseInterrupt(TIMER1_COMPB_vect);
+                break;
+            case Source::CompareC:
+                Mcu::RaiseInterrupt(TIMER1_COMPC_vect);
+                break;
+            case Source::Overflow1:
+                Mcu::RaiseInterrupt(TIMER1_OVF_vect);
+                break;
+            case Source::Overflow3:
+                Mcu::RaiseInterrupt(TIMER3_OVF_vect);
+                break;
+            default:
+                break;
+            }
+        }
+
+    }
+
+    // Runs one main loop pass worth of time. The events up to the input horizon
+    // run before more input is read, so a client that waits for the reply to a
+    // request does not stall the time.
+    void RunPass()
+    {
+        uint64_t target = g_cycles + g_options.m_loopCycles;
+        for (;;)
+        {
+            uint64_t horizon = g_transport.IsEnd() ? UINT64_MAX : ToCycles(g_transport.GetHorizon());
+            RunEvents(horizon < target ? horizon : target);
+            if (horizon >= target)
+                break;
+
+            g_transport.ReadNext();
+        }
+
+        Advance(target);
+
+        if (g_transport.IsEnd() && !g_transport.HasEvent())
+        {
+            Finish();
+        }
+    }
+
+    ssize_t WriteCookie(void*, const char* buffer, size_t size)
+    {
+        for (size_t i = 0; i < size; i++)
+        {
+            g_putchar(buffer[i]);
+        }
+
+        return size;
+    }
+
+    ssize_t ReadCookie(void*, char* buffer, size_t size)
+    {
+        if (size == 0)
+            return 0;
+
+        buffer[0] = g_getchar();
+        return 1;
+    }
+
+    void PrintUsage(const char* program)
+    {
+        fprintf(g_error,
+            "Usage: %s [options] [input file]\n"
+            "Runs the firmware against input events from a file, or from stdin.\n"
+            "  -s, --socket PATH     Take the input from a client on a Unix socket\n"
+            "  -l, --loop-time US    Virtual time per main loop pass, default 10 us\n"
+            "  -c, --cdc             Open the CDC port and print the text the firmware sends\n"
+            "  -t, --trace           Print the packets of the IN endpoints\n"
+            "  -u, --usb-stats       Print the USB register accesses per transfer\n"
+            "  -h, --help            Show this help\n",
+            program);
+    }
+
+    // Runs before the firmware's main(). Only saves the command line from glibc,
+    // since the C++ objects of this file are constructed after it.
+    __attribute__((constructor)) void SaveCommandLine(int argc, char** argv, char**)
+    {
+        g_argc = argc;
+        g_argv = argv;
+    }
+
+    // Runs at the first main loop pass, after the firmware has set up the MCU
+    void Start()
+    {
+        // The firmware takes over stdout and stderr, so the platform keeps its own copies
+        g_console = fdopen(dup(STDOUT_FILENO), "w");
+        g_error = fdopen(dup(STDERR_FILENO), "w");
+        if (g_console == nullptr || g_error == nullptr)
+            exit(1);
+
+        static const option longOptions[] =
+        {
+            { "socket", required_argument, nullptr, 's' },
+            { "loop-time", required_argument, nullptr, 'l' },
+            { "cdc", no_argument, nullptr, 'c' },
+            { "trace", no_argument, nullptr, 't' },
+            { "usb-stats", no_argument, nullptr, 'u' },
+            { "help", no_argument, nullptr, 'h' },
+            { nullptr, 0, nullptr, 0 },
+        };
+
+        int ch;
+        opterr = 0;
+        while ((ch = getopt_long(g_argc, g_argv, "s:l:ctuh", longOptions, nullptr)) != -1)
+        {
+            switch (ch)
+            {
+            case 's':
+                g_options.m_socket = optarg;
+                break;
+            case 'l':
+                g_options.m_loopCycles = static_cast<uint64_t>(atof(optarg) * cyclesPerUs);
+                if (g_options.m_loopCycles == 0)
+                {
+                    PrintUsage(g_argv[0]);
+                    exit(2);
+                }
+                break;
+            case 'c':
+                g_options.m_cdc = true;
+                break;
+            case 't':
+                g_options.m_trace = true;
+                break;
+            case 'u':
+                g_options.m_usbStatistics = true;
+                break;
+            case 'h':
+                PrintUsage(g_argv[0]);
+                exit(0);
+            default:
+                PrintUsage(g_argv[0]);
+                exit(2);
+            }
+        }
+
+        if (optind < g_argc)
+        {
+            g_options.m_input = g_argv[optind++];
+        }
+
+        if (optind < g_argc)
+        {
+            PrintUsage(g_argv[0]);
+            exit(2);
+        }
+
+        if (g_options.m_socket != nullptr)
+        {
+            fprintf(g_error, "Waiting for a client on %s\n", g_options.m_socket);
+            fflush(g_error);
+        }
+
+        bool isOpen = g_options.m_socket != nullptr
+            ? g_transport.OpenSocket(g_options.m_socket)
+            : g_transport.OpenFile(g_options.m_input);
+        if (!isOpen)
+        {
+            fprintf(g_error, "Cannot open %s: %s\n", g_options.m_socket != nullptr ? g_options.m_socket : g_options.m_input, strerror(errno));
+            exit(1);
+        }
+
+        g_usb.SetPacketHandler(OnPacket);
+        clock_gettime(CLOCK_MONOTONIC, &g_startTime);
+    }
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+uint64_t Mcu::GetCycles()
+{
+    return g_cycles;
+}
+
+uint64_t Mcu::GetNanoseconds()
+{
+    return ToNanoseconds(g_cycles);
+}
+
+void Mcu::RaiseInterrupt(Vector vector)
+{
+    for (auto& info : g_vectors)
+    {
+        if (info.m_vector == vector)
+        {
+            info.m_count++;
+        }
+    }
+
+    uint8_t sreg = SREG;
+    SREG = sreg & ~_BV(SREG_I);
+    vector();
+    SREG = sreg;
+}
+
+void Mcu::Fail(const char* format, ...)
+{
+    // The descriptor is still the process's stderr, even if the firmware took over the stream
+    FILE* out = g_error != nullptr ? g_error : fdopen(dup(STDERR_FILENO), "w");
+    if (g_console != nullptr)
+    {
+        fflush(g_console);
+    }
+
+    fprintf(out, "%.3f us: ", ToNanoseconds(g_cycles) / 1000.0);
+
+    va_list args;
+    va_start(args, format);
+    vfprintf(out, format, args);
+    va_end(args);
+
+    fprintf(out, "\n");
+    fflush(out);
+    exit(1);
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+// The platform takes each timer interrupt in the cycle it comes due, which clears
+// its flag, so the firmware never sees a flag pending. Writing a one clears a flag.
+uint8_t HostPlatform::ReadRegister(uint8_t reg)
+{
+    if (reg == Tifr1 || reg == Tifr3)
+        return 0;
+
+    return g_usb.ReadRegister(reg);
+}
+
+void HostPlatform::WriteRegister(uint8_t reg, uint8_t value)
+{
+    if (reg == Tifr1 || reg == Tifr3)
+        return;
+
+    g_usb.WriteRegister(reg, value);
+}
+
+void HostPlatform::OnWatchdogReset()
+{
+    if (!g_isStarted)
+    {
+        g_isStarted = true;
+        Start();
+
+        if (!g_usb.IsAttached())
+            Mcu::Fail("The firmware did not attach to the USB bus");
+
+        g_usb.Connect(g_options.m_cdc);
+        g_nextFrame = g_cycles + cyclesPerFrame;
+    }
+
+    g_statistics.m_passes++;
+    g_usb.OnMainLoopPass();
+
+    // Interrupts are taken only while they are enabled, as on the MCU
+    if ((SREG & _BV(SREG_I)) == 0)
+        Mcu::Fail("The main loop runs with interrupts disabled");
+
+    RunPass();
+}
+
+void HostPlatform::ResetToBootloader()
+{
+    fprintf(g_console, "\nThe firmware resets to the bootloader\n");
+    Finish();
+}
+
+void HostPlatform::SetupStdin(char (*getchar)())
+{
+    g_getchar = getchar;
+
+    cookie_io_functions_t functions = {};
+    functions.read = ReadCookie;
+    FILE* file = fopencookie(nullptr, "r", functions);
+    setvbuf(file, nullptr, _IONBF, 0);
+    stdin = file;
+}
+
+void HostPlatform::SetupStdout(void (*putchar)(char ch))
+{
+    g_putchar = putchar;
+
+    cookie_io_functions_t functions = {};
+    functions.write = WriteCookie;
+    FILE* file = fopencookie(nullptr, "w", functions);
+    setvbuf(file, nullptr, _IONBF, 0);
+    stdout = file;
+    stderr = file;
+}
@@ -0,0 +1,339 @@
+//
+// host_transport.cpp
+// Copyright (C) 2018 Marius Greuel
+// SPDX-License-Identifier: GPL-3.0-or-later
+//
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "host.h"
+
+// Socket messages are [type] [endpoint] [payload size, 16-bit] [payload],
+// multi-byte values are little-endian and times are in ns.
+static const uint8_t messageLevel = 'L';     // Client: [time, 64-bit] [level]
+static const uint8_t messageData = 'B';      // Client: [time, 64-bit] [byte received by USART1]
+static const uint8_t messageWait = 'W';      // Client: [time, 64-bit], lets the time run up to it
+static const uint8_t messageRequest = 'S';   // Client: [SETUP packet] [OUT data]
+static const uint8_t messageOut = 'O';       // Client: [OUT data] for the endpoint
+static const uint8_t messageStatus = 'C';    // Device: [status: 0 ACK, 1 STALL, 2 no handshake] [IN data]
+static const uint8_t messageIn = 'I';        // Device: [time, 64-bit] [packet the host read from the endpoint]
+
+static const size_t headerSize = 4;
+static const size_t setupSize = 8;
+static const uint64_t ppmPulseWidth = 300000;
+
+static uint64_t ReadUInt64(const uint8_t* data)
+{
+    uint64_t value = 0;
+    for (uint8_t i = 0; i < 8; i++)
+    {
+        value |= static_cast<uint64_t>(data[i]) << (i * 8);
+    }
+
+    return value;
+}
+
+static void WriteUInt64(Packet& packet, uint64_t value)
+{
+    for (uint8_t i = 0; i < 8; i++)
+    {
+        packet.push_back(static_cast<uint8_t>(value >> (i * 8)));
+    }
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+bool Transport::OpenFile(const char* path)
+{
+    m_file = strcmp(path, "-") == 0 ? stdin : fopen(path, "r");
+    return m_file != nullptr;
+}
+
+bool Transport::OpenSocket(const char* path)
+{
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener < 0)
+        return false;
+
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    strncpy(address.sun_path, path, sizeof(address.sun_path) - 1);
+    unlink(path);
+
+    if (bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || listen(listener, 1) != 0)
+    {
+        close(listener);
+        return false;
+    }
+
+    m_socket = accept(listener, nullptr, nullptr);
+    close(listener);
+    unlink(path);
+    return m_socket >= 0;
+}
+
+void Transport::ReadNext()
+{
+    if (!m_isEnd && !(m_socket >= 0 ? ReadMessage() : ReadLine()))
+    {
+        m_isEnd = true;
+    }
+}
+
+void Transport::SendInPacket(uint64_t time, uint8_t endpoint, const Packet& packet)
+{
+    if (m_socket < 0)
+        return;
+
+    Packet payload;
+    WriteUInt64(payload, time);
+    payload.insert(payload.end(), packet.begin(), packet.end());
+    WriteMessage(messageIn, endpoint, payload);
+}
+
+void Transport::SendRequestStatus(uint8_t status, const Packet& data)
+{
+    if (m_socket < 0)
+        return;
+
+    Packet payload;
+    payload.push_back(status);
+    payload.insert(payload.end(), data.begin(), data.end());
+    WriteMessage(messageStatus, 0, payload);
+}
+
+// <time in us> high|low
+// <time in us> byte <value>
+// <time in us> wait
+// <time in us> request <8 bytes of the SETUP packet> [OUT data bytes]
+// <time in us> out <endpoint> <data bytes>
+// <time in us> ppm <frames> <frame period in us> <channel widths in us>
+bool Transport::ReadLine()
+{
+    char line[1024];
+    if (fgets(line, sizeof(line), m_file) == nullptr)
+        return false;
+
+    m_line++;
+
+    char* comment = strchr(line, '#');
+    if (comment != nullptr)
+    {
+        *comment = '\0';
+    }
+
+    char* token = strtok(line, " \t\r\n");
+    if (token == nullptr)
+        return true;
+
+    char* end;
+    double us = strtod(token, &end);
+    if (*end != '\0' || us < 0)
+        Mcu::Fail("Line %u: Invalid time '%s'", m_line, token);
+
+    const char* command = strtok(nullptr, " \t\r\n");
+    if (command == nullptr)
+        Mcu::Fail("Line %u: Missing command", m_line);
+
+    std::vector<uint32_t> numbers;
+    Packet values;
+    while ((token = strtok(nullptr, " \t\r\n")) != nullptr)
+    {
+        unsigned long value = strtoul(token, &end, 0);
+        if (*end != '\0' || value > UINT32_MAX)
+            Mcu::Fail("Line %u: Invalid number '%s'", m_line, token);
+
+        numbers.push_back(static_cast<uint32_t>(value));
+        values.push_back(static_cast<uint8_t>(value));
+    }
+
+    InputEvent event = {};
+    event.m_time = static_cast<uint64_t>(us * 1000 + 0.5);
+    if (strcmp(command, "ppm") == 0 && numbers.size() >= 3)
+    {
+        AddPpmFrames(event.m_time, numbers[0], numbers[1], std::vector<uint32_t>(numbers.begin() + 2, numbers.end()));
+        return true;
+    }
+
+    for (size_t i = 0; i < numbers.size(); i++)
+    {
+        if (numbers[i] > 0xFF)
+            Mcu::Fail("Line %u: Invalid byte %u", m_line, numbers[i]);
+    }
+
+    if (strcmp(command, "high") == 0 || strcmp(command, "low") == 0)
+    {
+        event.m_type = InputEvent::Type::Level;
+        event.m_value = command[0] == 'h';
+    }
+    else if (strcmp(command, "byte") == 0 && values.size() == 1)
+    {
+        event.m_type = InputEvent::Type::Data;
+        event.m_value = values[0];
+    }
+    else if (strcmp(command, "wait") == 0 && values.empty())
+    {
+        SetHorizon(event.m_time);
+        return true;
+    }
+    else if (strcmp(command, "request") == 0 && values.size() >= setupSize)
+    {
+        event.m_type = InputEvent::Type::Request;
+        event.m_payload = values;
+    }
+    else if (strcmp(command, "out") == 0 && values.size() >= 2)
+    {
+        event.m_type = InputEvent::Type::Out;
+        event.m_value = values[0];
+        event.m_payload.assign(values.begin() + 1, values.end());
+    }
+    else
+    {
+        Mcu::Fail("Line %u: Invalid command '%s'", m_line, command);
+    }
+
+    AddEvent(event);
+    return true;
+}
+
+bool Transport::ReadMessage()
+{
+    uint8_t header[headerSize];
+    if (!ReadExactly(header, sizeof(header)))
+        return false;
+
+    Packet payload(header[2] | (header[3] << 8));
+    if (!payload.empty() && !ReadExactly(&payload[0], payload.size()))
+        return false;
+
+    InputEvent event = {};
+    event.m_time = m_horizon;
+    switch (header[0])
+    {
+    case messageLevel:
+    case messageData:
+        if (payload.size() != 9)
+            Mcu::Fail("Invalid message '%c'", header[0]);
+
+        event.m_type = header[0] == messageLevel ? InputEvent::Type::Level : InputEvent::Type::Data;
+        event.m_time = ReadUInt64(&payload[0]);
+        event.m_value = payload[8];
+        break;
+    case messageWait:
+        if (payload.size() != 8)
+            Mcu::Fail("Invalid message '%c'", header[0]);
+
+        SetHorizon(ReadUInt64(&payload[0]));
+        return true;
+    case messageRequest:
+        if (payload.size() < setupSize)
+            Mcu::Fail("Invalid message '%c'", header[0]);
+
+        event.m_type = InputEvent::Type::Request;
+        event.m_payload = payload;
+        break;
+    case messageOut:
+        event.m_type = InputEvent::Type::Out;
+        event.m_value = header[1];
+        event.m_payload = payload;
+        break;
+    default:
+        Mcu::Fail("Unknown message type 0x%02X", header[0]);
+    }
+
+    AddEvent(event);
+    return true;
+}
+
+bool Transport::ReadExactly(void* buffer, size_t size)
+{
+    uint8_t* data = static_cast<uint8_t*>(buffer);
+    while (size > 0)
+    {
+        ssize_t count = recv(m_socket, data, size, 0);
+        if (count < 0 && errno == EINTR)
+            continue;
+
+        if (count <= 0)
+            return false;
+
+        data += count;
+        size -= count;
+    }
+
+    return true;
+}
+
+void Transport::WriteMessage(uint8_t type, uint8_t endpoint, const Packet& payload)
+{
+    Packet message = { type, endpoint, static_cast<uint8_t>(payload.size()), static_cast<uint8_t>(payload.size() >> 8) };
+    message.insert(message.end(), payload.begin(), payload.end());
+
+    const uint8_t* data = &message[0];
+    size_t size = message.size();
+    while (size > 0)
+    {
+        ssize_t count = send(m_socket, data, size, MSG_NOSIGNAL);
+        if (count < 0 && errno == EINTR)
+            continue;
+
+        // The client has gone, the run ends when the input does
+        if (count <= 0)
+            return;
+
+        data += count;
+        size -= count;
+    }
+}
+
+// A PPM frame is a low pulse at the start of each channel and one more at
+// the end of the last channel, the signal idles high until the next frame.
+void Transport::AddPpmFrames(uint64_t time, uint32_t frames, uint32_t period, const std::vector<uint32_t>& widths)
+{
+    uint64_t frameTime = ppmPulseWidth;
+    for (auto width : widths)
+    {
+        if (width * 1000ULL <= ppmPulseWidth)
+            Mcu::Fail("Line %u: Invalid channel width %u", m_line, width);
+
+        frameTime += width * 1000ULL;
+    }
+
+    if (frameTime >= period * 1000ULL)
+        Mcu::Fail("Line %u: The channels do not fit into the frame period", m_line);
+
+    for (uint32_t frame = 0; frame < frames; frame++)
+    {
+        uint64_t edgeTime = time + frame * period * 1000ULL;
+        for (size_t i = 0; i <= widths.size(); i++)
+        {
+            InputEvent low = { edgeTime, InputEvent::Type::Level, 0, Packet() };
+            InputEvent high = { edgeTime + ppmPulseWidth, InputEvent::Type::Level, 1, Packet() };
+            AddEvent(low);
+            AddEvent(high);
+
+            if (i < widths.size())
+            {
+                edgeTime += widths[i] * 1000ULL;
+            }
+        }
+    }
+}
+
+void Transport::AddEvent(InputEvent& event)
+{
+    SetHorizon(event.m_time);
+    m_events.push_back(std::move(event));
+}
+
+void Transport::SetHorizon(uint64_t time)
+{
+    if (time < m_horizon)
+        Mcu::Fail("Input %u: The time goes backwards", m_line);
+
+    m_horizon = time;
+}
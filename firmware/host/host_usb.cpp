@@ -0,0 +1,714 @@
+//
+// host_usb.cpp
+// Copyright (C) 2018 Marius Greuel
+// SPDX-License-Identifier: GPL-3.0-or-later
+//
+
+// The USB device controller of the ATmega32U4, as far as atl/usb_driver.h uses it,
+// with a host that always takes control transfers right away and polls the
+// IN endpoints at the start of each frame.
+
+#include <algorithm>
+#include "host.h"
+#include <avr/io.h>
+
+extern "C" void USB_GEN_vect();
+extern "C" void USB_COM_vect();
+
+static const uint8_t endpointTypeControl = 0;
+static const uint8_t endpointTypeInterrupt = 3;
+
+// A firmware bug that waits for a flag the host never sets would otherwise hang.
+static const uint32_t maxSpinCount = 10000000;
+
+/////////////////////////////////////////////////////////////////////////////
+
+bool UsbModel::Endpoint::IsAllocated() const
+{
+    return (m_uecfg1x & _BV(ALLOC)) != 0;
+}
+
+bool UsbModel::Endpoint::IsControl() const
+{
+    return (m_uecfg0x >> EPTYPE0) == endpointTypeControl;
+}
+
+bool UsbModel::Endpoint::IsIn() const
+{
+    return (m_uecfg0x & _BV(EPDIR)) != 0;
+}
+
+bool UsbModel::Endpoint::IsInterrupt() const
+{
+    return (m_uecfg0x >> EPTYPE0) == endpointTypeInterrupt;
+}
+
+uint16_t UsbModel::Endpoint::GetSize() const
+{
+    return 8 << ((m_uecfg1x >> EPSIZE0) & 7);
+}
+
+uint8_t UsbModel::Endpoint::GetBanks() const
+{
+    return (m_uecfg1x & _BV(EPBK0)) != 0 ? 2 : 1;
+}
+
+// An IN bank is free until the host has read it.
+bool UsbModel::Endpoint::IsBankFree() const
+{
+    return m_packets.size() < GetBanks();
+}
+
+void UsbModel::Endpoint::Reset()
+{
+    m_fifo.clear();
+    m_packets.clear();
+    m_setupReceived = false;
+    m_outReceived = false;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+bool UsbModel::IsAttached() const
+{
+    return (USBCON & (_BV(USBE) | _BV(FRZCLK))) == _BV(USBE) && (UDCON & _BV(DETACH)) == 0;
+}
+
+void UsbModel::Connect(bool openCdcPort)
+{
+    m_isConnected = true;
+    for (auto& endpoint : m_endpoints)
+    {
+        endpoint = Endpoint();
+    }
+
+    RaiseGeneralInterrupt(_BV(EORSTI), _BV(EORSTE));
+
+    Packet descriptor;
+    if (Request(0x80, 6, 0x0100, 0, 64, descriptor) != Status::Ack || descriptor.size() < 18)
+        Mcu::Fail("Failed to get the device descriptor");
+
+    if (Request(0x00, 5, 1, 0, 0, descriptor) != Status::Ack)
+        Mcu::Fail("Failed to set the address");
+
+    if (Request(0x80, 6, 0x0200, 0, 9, descriptor) != Status::Ack || descriptor.size() < 9)
+        Mcu::Fail("Failed to get the configuration descriptor");
+
+    uint16_t totalLength = static_cast<uint16_t>(descriptor[2] | (descriptor[3] << 8));
+    if (Request(0x80, 6, 0x0200, 0, totalLength, descriptor) != Status::Ack || descriptor.size() != totalLength)
+        Mcu::Fail("Failed to get the configuration descriptor");
+
+    ParseConfigurationDescriptor(descriptor);
+
+    if (Request(0x00, 9, 1, 0, 0, descriptor) != Status::Ack)
+        Mcu::Fail("Failed to set the configuration");
+
+    if (openCdcPort)
+    {
+        // SET_CONTROL_LINE_STATE with DTR and RTS
+        if (Request(0x21, 0x22, 3, m_cdcInterface, 0, descriptor) != Status::Ack)
+            Mcu::Fail("Failed to open the CDC port");
+    }
+}
+
+void UsbModel::OnStartOfFrame()
+{
+    m_frameNumber = (m_frameNumber + 1) & 0x7FF;
+    UDFNUM = m_frameNumber;
+
+    RaiseGeneralInterrupt(_BV(SOFI), _BV(SOFE));
+
+    for (uint8_t i = 1; i < endpointCount; i++)
+    {
+        Endpoint& endpoint = m_endpoints[i];
+        if (!endpoint.IsAllocated() || !endpoint.IsIn() || endpoint.m_packets.empty())
+            continue;
+
+        // An interrupt endpoint is polled once per interval, a bulk endpoint as often as it has data
+        if (endpoint.IsInterrupt() && m_frameNumber % endpoint.m_interval != 0)
+            continue;
+
+        do
+        {
+            Packet packet = endpoint.m_packets.front();
+            endpoint.m_packets.pop_front();
+            endpoint.m_statistics.m_packets++;
+            endpoint.m_statistics.m_bytes += packet.size();
+            if (m_packetHandler)
+            {
+                m_packetHandler(i, packet);
+            }
+        } while (!endpoint.IsInterrupt() && !endpoint.m_packets.empty());
+    }
+}
+
+UsbModel::Status UsbModel::ControlTransfer(const Setup& setup, const Packet& out, Packet& in)
+{
+    Endpoint& endpoint = m_endpoints[0];
+    if (!endpoint.IsAllocated())
+        return Status::NoHandshake;
+
+    if ((endpoint.m_ueienx & _BV(RXSTPE)) == 0)
+        Mcu::Fail("The firmware does not take SETUP packets by interrupt");
+
+    m_setup = setup;
+    m_controlAccess = &GetAccessStatistics(GetRequestName(setup));
+    m_controlAccess->m_transfers++;
+    m_controlIn.clear();
+    m_controlOut.clear();
+    if (!setup.IsDeviceToHost())
+    {
+        for (size_t offset = 0; offset < out.size(); offset += endpoint.GetSize())
+        {
+            size_t size = std::min<size_t>(out.size() - offset, endpoint.GetSize());
+            m_controlOut.push_back(Packet(out.begin() + offset, out.begin() + offset + size));
+        }
+    }
+
+    m_isControlInProgress = true;
+    m_isControlComplete = false;
+    m_isControlDataComplete = false;
+
+    // A SETUP packet clears a stall
+    endpoint.Reset();
+    endpoint.m_fifo.assign(setup.m_data, setup.m_data + sizeof(setup.m_data));
+    endpoint.m_setupReceived = true;
+    endpoint.m_ueconx &= ~_BV(STALLRQ);
+
+    Mcu::RaiseInterrupt(USB_COM_vect);
+
+    m_isControlInProgress = false;
+    m_controlTransfers++;
+    m_controlAccess->m_bytes += out.size() + m_controlIn.size();
+    in = m_controlIn;
+
+    if ((endpoint.m_ueconx & _BV(STALLRQ)) != 0)
+    {
+        m_stalledTransfers++;
+        return Status::Stall;
+    }
+
+    return m_isControlComplete ? Status::Ack : Status::NoHandshake;
+}
+
+void UsbModel::SendOut(uint8_t index, const Packet& data)
+{
+    if (index == 0 || index >= endpointCount)
+        return;
+
+    Endpoint& endpoint = m_endpoints[index];
+    if (!endpoint.IsAllocated() || endpoint.IsIn())
+        return;
+
+    for (size_t offset = 0; offset < data.size(); offset += endpoint.GetSize())
+    {
+        size_t size = std::min<size_t>(data.size() - offset, endpoint.GetSize());
+        endpoint.m_packets.push_back(Packet(data.begin() + offset, data.begin() + offset + size));
+    }
+
+    if (!endpoint.m_outReceived)
+    {
+        LoadOutPacket(endpoint);
+    }
+}
+
+const char* UsbModel::GetEndpointName(uint8_t index) const
+{
+    return m_endpoints[index].m_name != nullptr ? m_endpoints[index].m_name : "";
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+uint8_t UsbModel::ReadRegister(uint8_t reg)
+{
+    CountAccess(reg, false);
+
+    switch (reg)
+    {
+    case HostPlatform::Pllcsr:
+        // The PLL locks right away
+        return (m_pllcsr & _BV(PLLE)) != 0 ? m_pllcsr | _BV(PLOCK) : m_pllcsr;
+    case HostPlatform::Ueintx:
+        return ReadUeintx(GetSelectedEndpoint());
+    case HostPlatform::Uedatx:
+    {
+        Endpoint& endpoint = GetSelectedEndpoint();
+        if (endpoint.m_fifo.empty())
+            return 0;
+
+        uint8_t data = endpoint.m_fifo.front();
+        endpoint.m_fifo.pop_front();
+        return data;
+    }
+    case HostPlatform::Uebclx:
+        return static_cast<uint8_t>(GetSelectedEndpoint().m_fifo.size());
+    case HostPlatform::Ueconx:
+        return GetSelectedEndpoint().m_ueconx;
+    case HostPlatform::Uecfg0x:
+        return GetSelectedEndpoint().m_uecfg0x;
+    case HostPlatform::Uecfg1x:
+        return GetSelectedEndpoint().m_uecfg1x;
+    case HostPlatform::Uesta0x:
+    {
+        // NBUSYBK counts the IN banks the host has not read yet
+        auto& endpoint = GetSelectedEndpoint();
+        if (!endpoint.IsAllocated())
+            return 0;
+
+        return _BV(CFGOK) | (endpoint.IsIn() ? static_cast<uint8_t>(endpoint.m_packets.size()) : 0);
+    }
+    case HostPlatform::Ueienx:
+        return GetSelectedEndpoint().m_ueienx;
+    case HostPlatform::Udint:
+        return m_udint;
+    case HostPlatform::Uenum:
+        return m_uenum;
+    default:
+        return 0;
+    }
+}
+
+void UsbModel::WriteRegister(uint8_t reg, uint8_t value)
+{
+    switch (reg)
+    {
+    case HostPlatform::Pllcsr:
+        m_pllcsr = value & ~_BV(PLOCK);
+        break;
+    case HostPlatform::Ueintx:
+        WriteUeintx(GetSelectedEndpoint(), value);
+        break;
+    case HostPlatform::Uedatx:
+    {
+        Endpoint& endpoint = GetSelectedEndpoint();
+        bool isWritable = endpoint.IsControl() || (endpoint.IsIn() && endpoint.IsBankFree());
+        if (isWritable && endpoint.m_fifo.size() < endpoint.GetSize())
+        {
+            endpoint.m_fifo.push_back(value);
+        }
+        break;
+    }
+    case HostPlatform::Ueconx:
+    {
+        // STALLRQC and RSTDT are strobes
+        Endpoint& endpoint = GetSelectedEndpoint();
+        endpoint.m_ueconx = value & (_BV(STALLRQ) | _BV(EPEN));
+        if ((value & _BV(STALLRQC)) != 0)
+        {
+            endpoint.m_ueconx &= ~_BV(STALLRQ);
+        }
+        break;
+    }
+    case HostPlatform::Uecfg0x:
+        GetSelectedEndpoint().m_uecfg0x = value;
+        break;
+    case HostPlatform::Uecfg1x:
+        GetSelectedEndpoint().m_uecfg1x = value;
+        GetSelectedEndpoint().Reset();
+        break;
+    case HostPlatform::Ueienx:
+        GetSelectedEndpoint().m_ueienx = value;
+        break;
+    case HostPlatform::Uerst:
+        for (uint8_t i = 0; i < endpointCount; i++)
+        {
+            if ((value & _BV(i)) != 0)
+            {
+                m_endpoints[i].Reset();
+            }
+        }
+        break;
+    case HostPlatform::Udint:
+        // The firmware clears a flag by writing a zero to it, writing a one has no effect
+        m_udint &= value;
+        break;
+    case HostPlatform::Uenum:
+        m_uenum = value & 0x07;
+        m_isEndpointSelected = true;
+        break;
+    default:
+        break;
+    }
+
+    // After the write, so selecting an endpoint counts for that endpoint
+    CountAccess(reg, true);
+}
+
+UsbModel::Endpoint& UsbModel::GetSelectedEndpoint()
+{
+    uint8_t index = m_uenum;
+    if (index >= endpointCount)
+        Mcu::Fail("Invalid endpoint %u selected", index);
+
+    return m_endpoints[index];
+}
+
+uint8_t UsbModel::ReadUeintx(Endpoint& endpoint)
+{
+    if (++m_spinCount > maxSpinCount)
+        Mcu::Fail("The firmware waits for endpoint %u forever", m_uenum);
+
+    uint8_t ueintx = 0;
+    if (endpoint.IsControl())
+    {
+        ueintx |= _BV(TXINI);
+        if (endpoint.m_setupReceived)
+            ueintx |= _BV(RXSTPI);
+        if (endpoint.m_outReceived)
+            ueintx |= _BV(RXOUTI);
+    }
+    else if (endpoint.IsIn())
+    {
+        if (endpoint.IsBankFree())
+        {
+            ueintx |= _BV(TXINI) | _BV(FIFOCON);
+            if (endpoint.m_fifo.size() < endpoint.GetSize())
+                ueintx |= _BV(RWAL);
+        }
+    }
+    else
+    {
+        if (endpoint.m_outReceived)
+            ueintx |= _BV(RXOUTI) | _BV(FIFOCON);
+        if (!endpoint.m_fifo.empty())
+            ueintx |= _BV(RWAL);
+    }
+
+    return ueintx;
+}
+
+// The firmware clears a flag by writing a zero to it.
+void UsbModel::WriteUeintx(Endpoint& endpoint, uint8_t value)
+{
+    uint8_t cleared = ReadUeintx(endpoint) & ~value;
+    if (endpoint.IsControl())
+    {
+        if ((cleared & _BV(RXSTPI)) != 0)
+        {
+            endpoint.m_setupReceived = false;
+            endpoint.m_fifo.clear();
+            LoadOutPacket(endpoint);
+        }
+
+        if ((cleared & _BV(RXOUTI)) != 0)
+        {
+            endpoint.m_outReceived = false;
+            endpoint.m_fifo.clear();
+            if (m_isControlDataComplete)
+            {
+                // The firmware has taken the status stage of an IN transfer
+                m_isControlComplete = true;
+            }
+            else
+            {
+                LoadOutPacket(endpoint);
+            }
+        }
+
+        if ((cleared & _BV(TXINI)) != 0)
+        {
+            SendControlIn(endpoint);
+        }
+    }
+    else if (endpoint.IsIn())
+    {
+        if ((cleared & _BV(FIFOCON)) != 0)
+        {
+            endpoint.m_packets.push_back(Packet(endpoint.m_fifo.begin(), endpoint.m_fifo.end()));
+            endpoint.m_fifo.clear();
+            GetEndpointAccess(m_uenum).m_transfers++;
+            GetEndpointAccess(m_uenum).m_bytes += endpoint.m_packets.back().size();
+        }
+    }
+    else
+    {
+        if ((cleared & _BV(FIFOCON)) != 0)
+        {
+            GetEndpointAccess(m_uenum).m_transfers++;
+            GetEndpointAccess(m_uenum).m_bytes += endpoint.m_outSize;
+
+            endpoint.m_outReceived = false;
+            endpoint.m_fifo.clear();
+            LoadOutPacket(endpoint);
+        }
+    }
+}
+
+void UsbModel::SendControlIn(Endpoint& endpoint)
+{
+    Packet packet(endpoint.m_fifo.begin(), endpoint.m_fifo.end());
+    endpoint.m_fifo.clear();
+
+    if (!m_isControlInProgress)
+        return;
+
+    if (!m_setup.IsDeviceToHost())
+    {
+        // The status stage of an OUT transfer
+        m_isControlComplete = true;
+    }
+    else if (!m_isControlDataComplete)
+    {
+        m_controlIn.insert(m_controlIn.end(), packet.begin(), packet.end());
+
+        // A short packet, or all the data requested, ends the data stage,
+        // and the host sends the status stage right away.
+        if (packet.size() < endpoint.GetSize() || m_controlIn.size() >= m_setup.GetLength())
+        {
+            m_isControlDataComplete = true;
+            endpoint.m_outReceived = true;
+        }
+    }
+}
+
+void UsbModel::LoadOutPacket(Endpoint& endpoint)
+{
+    auto& packets = endpoint.IsControl() ? m_controlOut : endpoint.m_packets;
+    if (!packets.empty())
+    {
+        endpoint.m_fifo.assign(packets.front().begin(), packets.front().end());
+        endpoint.m_outSize = static_cast<uint16_t>(packets.front().size());
+        endpoint.m_outReceived = true;
+        packets.pop_front();
+    }
+}
+
+UsbModel::Status UsbModel::Request(uint8_t requestType, uint8_t request, uint16_t value, uint16_t index, uint16_t length, Packet& in)
+{
+    Setup setup =
+    {
+        {
+            requestType,
+            request,
+            static_cast<uint8_t>(value),
+            static_cast<uint8_t>(value >> 8),
+            static_cast<uint8_t>(index),
+            static_cast<uint8_t>(index >> 8),
+            static_cast<uint8_t>(length),
+            static_cast<uint8_t>(length >> 8),
+        }
+    };
+
+    return ControlTransfer(setup, Packet(), in);
+}
+
+// Takes the endpoint intervals and what the endpoints are for from the descriptors.
+void UsbModel::ParseConfigurationDescriptor(const Packet& descriptor)
+{
+    static const uint8_t descriptorTypeInterface = 4;
+    static const uint8_t descriptorTypeEndpoint = 5;
+    static const uint8_t interfaceClassCdc = 0x02;
+    static const uint8_t interfaceClassHid = 0x03;
+    static const uint8_t interfaceClassCdcData = 0x0A;
+
+    uint8_t interfaceClass = 0;
+    for (size_t offset = 0; offset + 2 <= descriptor.size() && descriptor[offset] >= 2; offset += descriptor[offset])
+    {
+        const uint8_t* data = &descriptor[offset];
+        if (data[1] == descriptorTypeInterface && data[0] >= 9)
+        {
+            interfaceClass = data[5];
+            if (interfaceClass == interfaceClassCdc)
+            {
+                m_cdcInterface = data[2];
+            }
+        }
+        else if (data[1] == descriptorTypeEndpoint && data[0] >= 7)
+        {
+            uint8_t index = data[2] & 0x0F;
+            if (index == 0 || index >= endpointCount)
+                continue;
+
+            Endpoint& endpoint = m_endpoints[index];
+            endpoint.m_interval = data[6] != 0 ? data[6] : 1;
+            switch (interfaceClass)
+            {
+            case interfaceClassCdc:
+                endpoint.m_name = "CDC notification";
+                break;
+            case interfaceClassCdcData:
+                endpoint.m_name = (data[2] & 0x80) != 0 ? "CDC data in" : "CDC data out";
+                break;
+            case interfaceClassHid:
+                endpoint.m_name = "HID";
+                break;
+            default:
+                break;
+            }
+        }
+    }
+}
+
+void UsbModel::RaiseGeneralInterrupt(uint8_t flag, uint8_t enable)
+{
+    m_udint |= flag;
+    if ((UDIEN & enable) != 0)
+    {
+        GetAccessStatistics("USB_GEN interrupt").m_transfers++;
+        m_isGeneralInterrupt = true;
+        m_isEndpointSelected = false;
+        Mcu::RaiseInterrupt(USB_GEN_vect);
+        m_isGeneralInterrupt = false;
+    }
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+void UsbModel::CountAccess(uint8_t reg, bool isWrite)
+{
+    // The USB_GEN interrupt counts for an endpoint once it selects one, e.g. for the CDC data on SOF
+    AccessStatistics* access;
+    if (m_isControlInProgress)
+    {
+        access = m_controlAccess;
+    }
+    else if (m_isGeneralInterrupt && !m_isEndpointSelected)
+    {
+        access = &GetAccessStatistics("USB_GEN interrupt");
+    }
+    else
+    {
+        access = &GetEndpointAccess(m_uenum);
+    }
+
+    if (isWrite)
+    {
+        m_registerWrites[reg]++;
+        access->m_writes++;
+    }
+    else
+    {
+        m_registerReads[reg]++;
+        access->m_reads++;
+        if (reg == HostPlatform::Ueintx)
+        {
+            access->m_polls++;
+        }
+    }
+}
+
+UsbModel::AccessStatistics& UsbModel::GetEndpointAccess(uint8_t index)
+{
+    Endpoint& endpoint = m_endpoints[index];
+    if (endpoint.m_access == nullptr)
+    {
+        char name[32];
+        const char* endpointName = GetEndpointName(index);
+        snprintf(name, sizeof(name), *endpointName != '\0' ? "EP%u %s" : "EP%u", index, endpointName);
+        endpoint.m_access = &GetAccessStatistics(name);
+    }
+
+    return *endpoint.m_access;
+}
+
+UsbModel::AccessStatistics& UsbModel::GetAccessStatistics(const std::string& name)
+{
+    for (auto& access : m_accessStatistics)
+    {
+        if (access.m_name == name)
+            return access;
+    }
+
+    m_accessStatistics.push_back(AccessStatistics());
+    m_accessStatistics.back().m_name = name;
+    return m_accessStatistics.back();
+}
+
+std::string UsbModel::GetRequestName(const Setup& setup) const
+{
+    static const char* const standardRequests[] =
+    {
+        "GET_STATUS", "CLEAR_FEATURE", nullptr, "SET_FEATURE", nullptr, "SET_ADDRESS", "GET_DESCRIPTOR",
+        "SET_DESCRIPTOR", "GET_CONFIGURATION", "SET_CONFIGURATION", "GET_INTERFACE", "SET_INTERFACE",
+    };
+
+    uint8_t type = (setup.GetRequestType() >> 5) & 3;
+    uint8_t request = setup.m_data[1];
+    uint8_t valueLow = setup.m_data[2];
+    uint8_t valueHigh = setup.m_data[3];
+    uint8_t index = setup.m_data[4];
+
+    char name[48];
+    if (type == 0 && request == 6)
+    {
+        switch (valueHigh)
+        {
+        case 1:
+            return "GET_DESCRIPTOR device";
+        case 2:
+            return "GET_DESCRIPTOR configuration";
+        case 3:
+            snprintf(name, sizeof(name), "GET_DESCRIPTOR string %u", valueLow);
+            return name;
+        case 0x21:
+            return "GET_DESCRIPTOR HID";
+        case 0x22:
+            return "GET_DESCRIPTOR HID report";
+        default:
+            snprintf(name, sizeof(name), "GET_DESCRIPTOR 0x%02X", valueHigh);
+            return name;
+        }
+    }
+    else if (type == 0 && request < sizeof(standardRequests) / sizeof(standardRequests[0]) && standardRequests[request] != nullptr)
+    {
+        return standardRequests[request];
+    }
+    else if (type == 1 && index == m_cdcInterface && request >= 0x20 && request <= 0x22)
+    {
+        static const char* const cdcRequests[] = { "SET_LINE_CODING", "GET_LINE_CODING", "SET_CONTROL_LINE_STATE" };
+        return cdcRequests[request - 0x20];
+    }
+    else if (type == 1)
+    {
+        switch (request)
+        {
+        case 0x01:
+            snprintf(name, sizeof(name), "GET_REPORT %u", valueLow);
+            return name;
+        case 0x09:
+            snprintf(name, sizeof(name), "SET_REPORT %u", valueLow);
+            return name;
+        case 0x02:
+            return "GET_IDLE";
+        case 0x0A:
+            return "SET_IDLE";
+        case 0x03:
+            return "GET_PROTOCOL";
+        case 0x0B:
+            return "SET_PROTOCOL";
+        default:
+            break;
+        }
+    }
+
+    snprintf(name, sizeof(name), "Request %02X %02X", setup.GetRequestType(), request);
+    return name;
+}
+
+void UsbModel::PrintAccessStatistics(FILE* file) const
+{
+    static const char* const registerNames[HostPlatform::RegisterCount] =
+    {
+        "PLLCSR", "UEINTX", "UEDATX", "UEBCLX", "UECONX", "UECFG0X",
+        "UECFG1X", "UESTA0X", "UEIENX", "UERST", "UDINT", "UENUM",
+    };
+
+    fprintf(file, "USB register accesses per transfer, packet, or interrupt:\n");
+    fprintf(file, "  %-32s %8s %8s %8s %8s %8s\n", "", "Count", "Bytes", "Reads", "Writes", "Polls");
+    for (const auto& access : m_accessStatistics)
+    {
+        if (access.m_transfers == 0)
+            continue;
+
+        double count = access.m_transfers;
+        fprintf(file, "  %-32s %8u %8.1f %8.1f %8.1f %8.1f\n", access.m_name.c_str(), access.m_transfers,
+            access.m_bytes / count, access.m_reads / count, access.m_writes / count, access.m_polls / count);
+    }
+
+    fprintf(file, "USB register accesses:\n");
+    for (uint8_t i = 0; i < HostPlatform::RegisterCount; i++)
+    {
+        fprintf(file, "  %-8s %12llu reads %12llu writes\n", registerNames[i],
+            static_cast<unsigned long long>(m_registerReads[i]), static_cast<unsigned long long>(m_registerWrites[i]));
+    }
+}
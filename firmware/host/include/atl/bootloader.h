@@ -0,0 +1,36 @@
+//
+// bootloader.h
+// Copyright (C) 2018 Marius Greuel
+// SPDX-License-Identifier: GPL-3.0-or-later
+//
+
+// Host build of atl/bootloader.h: there is no bootloader and no signature row.
+
+#pragma once
+#include <host_platform.h>
+#include <stdint.h>
+
+namespace atl
+{
+    class Bootloader
+    {
+    public:
+        static void ResetToBootloader()
+        {
+            HostPlatform::ResetToBootloader();
+        }
+
+        static void GetSerialNumber(uint8_t* serial, uint8_t count)
+        {
+            for (uint8_t i = 0; i < count; i++)
+            {
+                serial[i] = GetSignatureByte(0x000E + i);
+            }
+        }
+
+        static uint8_t GetSignatureByte(uint16_t address)
+        {
+            return static_cast<uint8_t>(address);
+        }
+    };
+}
@@ -0,0 +1,32 @@
+//
+// std_streams.h
+// Copyright (C) 2018 Marius Greuel
+// SPDX-License-Identifier: GPL-3.0-or-later
+//
+
+// Host build of atl/std_streams.h: the platform redirects the C streams,
+// since a FILE cannot be set up the avr-libc way.
+
+#pragma once
+#include <host_platform.h>
+#include <stdio.h>
+
+namespace atl
+{
+    class StdStreams
+    {
+    public:
+        using getchar_t = char(*)(void);
+        using putchar_t = void(*)(char ch);
+
+        static void SetupStdin(getchar_t getchar)
+        {
+            HostPlatform::SetupStdin(getchar);
+        }
+
+        static void SetupStdout(putchar_t putchar)
+        {
+            HostPlatform::SetupStdout(putchar);
+        }
+    };
+}
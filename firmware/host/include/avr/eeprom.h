@@ -0,0 +1,90 @@
+//
+// eeprom.h
+// Copyright (C) 2018 Marius Greuel
+// SPDX-License-Identifier: GPL-3.0-or-later
+//
+
+// The EEPROM is the .eeprom section of the process, it starts out zeroed
+// and is not kept between runs.
+
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#define EEMEM __attribute__((section(".eeprom")))
+
+inline int eeprom_is_ready()
+{
+    return 1;
+}
+
+inline void eeprom_busy_wait()
+{
+}
+
+inline void eeprom_read_block(void* destination, const void* source, size_t size)
+{
+    memcpy(destination, source, size);
+}
+
+inline void eeprom_write_block(const void* source, void* destination, size_t size)
+{
+    memcpy(destination, source, size);
+}
+
+inline void eeprom_update_block(const void* source, void* destination, size_t size)
+{
+    memcpy(destination, source, size);
+}
+
+inline uint8_t eeprom_read_byte(const uint8_t* address)
+{
+    return *address;
+}
+
+inline uint16_t eeprom_read_word(const uint16_t* address)
+{
+    uint16_t value;
+    eeprom_read_block(&value, address, sizeof(value));
+    return value;
+}
+
+inline uint32_t eeprom_read_dword(const uint32_t* address)
+{
+    uint32_t value;
+    eeprom_read_block(&value, address, sizeof(value));
+    return value;
+}
+
+inline float eeprom_read_float(const float* address)
+{
+    float value;
+    eeprom_read_block(&value, address, sizeof(value));
+    return value;
+}
+
+inline void eeprom_write_byte(uint8_t* address, uint8_t value)
+{
+    *address = value;
+}
+
+inline void eeprom_write_word(uint16_t* address, uint16_t value)
+{
+    eeprom_write_block(&value, address, sizeof(value));
+}
+
+inline void eeprom_write_dword(uint32_t* address, uint32_t value)
+{
+    eeprom_write_block(&value, address, sizeof(value));
+}
+
+inline void eeprom_write_float(float* address, float value)
+{
+    eeprom_write_block(&value, address, sizeof(value));
+}
+
+inline void eeprom_update_byte(uint8_t* address, uint8_t value)
+{
+    eeprom_write_byte(address, value);
+}
@@ -0,0 +1,22 @@
+//
+// interrupt.h
+// Copyright (C) 2018 Marius Greuel
+// SPDX-License-Identifier: GPL-3.0-or-later
+//
+
+#pragma once
+#include <avr/io.h>
+
+// The platform calls the handlers with the I flag cleared, like the hardware does.
+// It provides empty defaults for the vectors the firmware does not handle.
+#define ISR(vector, ...) extern "C" void vector(void); extern "C" void vector(void)
+
+inline void sei()
+{
+    SREG |= _BV(SREG_I);
+}
+
+inline void cli()
+{
+    SREG &= ~_BV(SREG_I);
+}
@@ -0,0 +1,239 @@
+//
+// io.h
+// Copyright (C) 2018 Marius Greuel
+// SPDX-License-Identifier: GPL-3.0-or-later
+//
+
+// The ATmega32U4 registers the firmware uses, for the host build.
+// Plain registers are variables in host_platform.cpp, which the platform updates
+// before it takes an interrupt. Registers with side effects are HostRegister objects.
+
+#pragma once
+#include <host_platform.h>
+#include <stdint.h>
+
+#ifndef __AVR_ATmega32U4__
+#define __AVR_ATmega32U4__ 1
+#endif
+
+#define _BV(bit) (1 << (bit))
+
+extern volatile uint8_t SREG;
+extern volatile uint8_t MCUSR;
+extern volatile uint8_t GPIOR0;
+extern volatile uint8_t GPIOR1;
+extern volatile uint8_t GPIOR2;
+
+// Ports
+extern volatile uint8_t PINB;
+extern volatile uint8_t DDRB;
+extern volatile uint8_t PORTB;
+extern volatile uint8_t PINC;
+extern volatile uint8_t DDRC;
+extern volatile uint8_t PORTC;
+extern volatile uint8_t PIND;
+extern volatile uint8_t DDRD;
+extern volatile uint8_t PORTD;
+extern volatile uint8_t PINF;
+extern volatile uint8_t DDRF;
+extern volatile uint8_t PORTF;
+
+// Pin change interrupts
+extern volatile uint8_t PCICR;
+extern volatile uint8_t PCIFR;
+extern volatile uint8_t PCMSK0;
+
+// Analog comparator and ADC multiplexer
+extern volatile uint8_t ACSR;
+extern volatile uint8_t ADCSRA;
+extern volatile uint8_t ADCSRB;
+extern volatile uint8_t ADMUX;
+
+// Timer0
+extern volatile uint8_t TCCR0A;
+extern volatile uint8_t TCCR0B;
+
+// Timer1
+extern volatile uint8_t TCCR1A;
+extern volatile uint8_t TCCR1B;
+extern volatile uint8_t TIMSK1;
+extern volatile uint16_t TCNT1;
+extern volatile uint16_t ICR1;
+extern volatile uint16_t OCR1B;
+extern volatile uint16_t OCR1C;
+
+// Timer3
+extern volatile uint8_t TCCR3A;
+extern volatile uint8_t TCCR3B;
+extern volatile uint8_t TIMSK3;
+extern volatile uint16_t TCNT3;
+
+// USART1
+extern volatile uint8_t UCSR1A;
+extern volatile uint8_t UCSR1B;
+extern volatile uint8_t UCSR1C;
+extern volatile uint16_t UBRR1;
+extern volatile uint8_t UDR1;
+
+// USB controller
+extern volatile uint8_t UHWCON;
+extern volatile uint8_t USBCON;
+extern volatile uint8_t UDCON;
+extern volatile uint8_t UDIEN;
+extern volatile uint8_t UDADDR;
+extern volatile uint16_t UDFNUM;
+
+#define PLLCSR (HostRegister(HostPlatform::Pllcsr))
+#define UDINT (HostRegister(HostPlatform::Udint))
+#define UENUM (HostRegister(HostPlatform::Uenum))
+#define UEINTX (HostRegister(HostPlatform::Ueintx))
+#define UEDATX (HostRegister(HostPlatform::Uedatx))
+#define UEBCLX (HostRegister(HostPlatform::Uebclx))
+#define UEBCX (static_cast<uint16_t>(UEBCLX))
+#define UECONX (HostRegister(HostPlatform::Ueconx))
+#define UECFG0X (HostRegister(HostPlatform::Uecfg0x))
+#define UECFG1X (HostRegister(HostPlatform::Uecfg1x))
+#define UESTA0X (HostRegister(HostPlatform::Uesta0x))
+#define UEIENX (HostRegister(HostPlatform::Ueienx))
+#define UERST (HostRegister(HostPlatform::Uerst))
+
+// Timer interrupt flags
+#define TIFR1 (HostRegister(HostPlatform::Tifr1))
+#define TIFR3 (HostRegister(HostPlatform::Tifr3))
+
+// Interrupt vectors the platform raises, see ISR() in avr/interrupt.h
+#define PCINT0_vect HostVector_PCINT0
+#define USB_GEN_vect HostVector_USB_GEN
+#define USB_COM_vect HostVector_USB_COM
+#define TIMER1_CAPT_vect HostVector_TIMER1_CAPT
+#define TIMER1_COMPB_vect HostVector_TIMER1_COMPB
+#define TIMER1_COMPC_vect HostVector_TIMER1_COMPC
+#define TIMER1_OVF_vect HostVector_TIMER1_OVF
+#define USART1_RX_vect HostVector_USART1_RX
+#define TIMER3_OVF_vect HostVector_TIMER3_OVF
+
+// SREG
+#define SREG_I 7
+
+// Port bits
+#define PB3 3
+#define PC7 7
+#define PD4 4
+#define PF7 7
+
+// PCICR, PCIFR, PCMSK0
+#define PCIE0 0
+#define PCIF0 0
+#define PCINT3 3
+
+// ACSR, ADCSRB, ADMUX
+#define ACD 7
+#define ACBG 6
+#define ACO 5
+#define ACI 4
+#define ACIE 3
+#define ACIC 2
+#define ACME 6
+#define MUX2 2
+#define MUX1 1
+#define MUX0 0
+
+// TCCR1B, TIMSK1, TIFR1
+#define ICNC1 7
+#define ICES1 6
+#define CS12 2
+#define CS11 1
+#define CS10 0
+#define ICIE1 5
+#define OCIE1C 3
+#define OCIE1B 2
+#define TOIE1 0
+#define ICF1 5
+#define OCF1C 3
+#define OCF1B 2
+#define TOV1 0
+
+// TCCR3B, TIMSK3, TIFR3
+#define CS32 2
+#define CS31 1
+#define CS30 0
+#define TOIE3 0
+#define TOV3 0
+
+// UCSR1A, UCSR1B, UCSR1C
+#define RXC1 7
+#define U2X1 1
+#define RXCIE1 7
+#define RXEN1 4
+#define UCSZ11 2
+#define UCSZ10 1
+
+// UHWCON, USBCON, PLLCSR
+#define UVREGE 0
+#define USBE 7
+#define FRZCLK 5
+#define OTGPADE 4
+#define PINDIV 4
+#define PLLE 1
+#define PLOCK 0
+
+// UDCON, UDINT, UDIEN, UDADDR
+#define RSTCPU 3
+#define LSM 2
+#define RMWKUP 1
+#define DETACH 0
+#define UPRSMI 6
+#define EORSMI 5
+#define WAKEUPI 4
+#define EORSTI 3
+#define SOFI 2
+#define SUSPI 0
+#define UPRSME 6
+#define EORSME 5
+#define WAKEUPE 4
+#define EORSTE 3
+#define SOFE 2
+#define SUSPE 0
+#define ADDEN 7
+
+// UERST, UECONX, UECFG0X, UECFG1X, UESTA0X
+#define EPRST6 6
+#define EPRST5 5
+#define EPRST4 4
+#define EPRST3 3
+#define EPRST2 2
+#define EPRST1 1
+#define EPRST0 0
+#define STALLRQ 5
+#define STALLRQC 4
+#define RSTDT 3
+#define EPEN 0
+#define EPTYPE1 7
+#define EPTYPE0 6
+#define EPDIR 0
+#define EPSIZE2 6
+#define EPSIZE1 5
+#define EPSIZE0 4
+#define EPBK1 3
+#define EPBK0 2
+#define ALLOC 1
+#define CFGOK 7
+#define NBUSYBK1 1
+#define NBUSYBK0 0
+
+// UEINTX, UEIENX
+#define FIFOCON 7
+#define NAKINI 6
+#define RWAL 5
+#define NAKOUTI 4
+#define RXSTPI 3
+#define RXOUTI 2
+#define STALLEDI 1
+#define TXINI 0
+#define FLERRE 7
+#define NAKINE 6
+#define NAKOUTE 4
+#define RXSTPE 3
+#define RXOUTE 2
+#define STALLEDE 1
+#define TXINE 0
@@ -0,0 +1,63 @@
+//
+// pgmspace.h
+// Copyright (C) 2018 Marius Greuel
+// SPDX-License-Identifier: GPL-3.0-or-later
+//
+
+// Program memory is ordinary memory on the host.
+
+#pragma once
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#define PROGMEM
+#define PSTR(s) (s)
+
+// avr-libc declares these in stdio.h
+#define printf_P printf
+#define sprintf_P sprintf
+#define snprintf_P snprintf
+
+inline uint8_t pgm_read_byte(const void* address)
+{
+    return *static_cast<const uint8_t*>(address);
+}
+
+inline uint16_t pgm_read_word(const void* address)
+{
+    uint16_t value;
+    memcpy(&value, address, sizeof(value));
+    return value;
+}
+
+inline uint32_t pgm_read_dword(const void* address)
+{
+    uint32_t value;
+    memcpy(&value, address, sizeof(value));
+    return value;
+}
+
+inline void* pgm_read_ptr(const void* address)
+{
+    void* value;
+    memcpy(&value, address, sizeof(value));
+    return value;
+}
+
+inline float pgm_read_float(const void* address)
+{
+    float value;
+    memcpy(&value, address, sizeof(value));
+    return value;
+}
+
+inline void* memcpy_P(void* destination, const void* source, size_t size)
+{
+    return memcpy(destination, source, size);
+}
+
+inline size_t strlen_P(const char* s)
+{
+    return strlen(s);
+}
@@ -0,0 +1,32 @@
+//
+// wdt.h
+// Copyright (C) 2018 Marius Greuel
+// SPDX-License-Identifier: GPL-3.0-or-later
+//
+
+#pragma once
+#include <host_platform.h>
+#include <stdint.h>
+
+#define WDTO_15MS 0
+#define WDTO_30MS 1
+#define WDTO_60MS 2
+#define WDTO_120MS 3
+#define WDTO_250MS 4
+#define WDTO_500MS 5
+#define WDTO_1S 6
+#define WDTO_2S 7
+
+// The watchdog never expires, since the virtual time only advances here.
+inline void wdt_reset()
+{
+    HostPlatform::OnWatchdogReset();
+}
+
+inline void wdt_enable(uint8_t /* timeout */)
+{
+}
+
+inline void wdt_disable()
+{
+}
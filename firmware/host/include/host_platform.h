@@ -0,0 +1,87 @@
+//
+// host_platform.h
+// Copyright (C) 2018 Marius Greuel
+// SPDX-License-Identifier: GPL-3.0-or-later
+//
+
+#pragma once
+#include <stdint.h>
+
+// Interface between the AVR headers in host/include and the virtual ATmega32U4
+// in host/*.cpp. The firmware is compiled with -fpack-struct and -fshort-enums,
+// the platform without, so only integers and function pointers cross it.
+class HostPlatform
+{
+public:
+    // Registers with side effects, accessed through HostRegister
+    static const uint8_t Pllcsr = 0;
+    static const uint8_t Ueintx = 1;
+    static const uint8_t Uedatx = 2;
+    static const uint8_t Uebclx = 3;
+    static const uint8_t Ueconx = 4;
+    static const uint8_t Uecfg0x = 5;
+    static const uint8_t Uecfg1x = 6;
+    static const uint8_t Uesta0x = 7;
+    static const uint8_t Ueienx = 8;
+    static const uint8_t Uerst = 9;
+    static const uint8_t Udint = 10;
+    static const uint8_t Uenum = 11;
+    static const uint8_t RegisterCount = 12;
+
+    // Timer interrupt flags, write one to clear
+    static const uint8_t Tifr1 = 12;
+    static const uint8_t Tifr3 = 13;
+
+    static uint8_t ReadRegister(uint8_t reg);
+    static void WriteRegister(uint8_t reg, uint8_t value);
+
+    // The firmware resets the watchdog once per main loop pass. The platform
+    // advances the virtual time and takes interrupts only here.
+    static void OnWatchdogReset();
+
+    // There is no bootloader to start, so the process ends.
+    [[noreturn]] static void ResetToBootloader();
+
+    static void SetupStdin(char (*getchar)());
+    static void SetupStdout(void (*putchar)(char ch));
+};
+
+// An I/O register whose accesses go to the platform, e.g. the USB FIFO.
+// The compound assignments take an int, like a uint8_t register would,
+// so expressions like REG &= ~_BV(BIT) compile without warnings.
+class HostRegister
+{
+public:
+    explicit HostRegister(uint8_t reg) : m_reg(reg)
+    {
+    }
+
+    operator uint8_t() const
+    {
+        return HostPlatform::ReadRegister(m_reg);
+    }
+
+    const HostRegister& operator=(uint8_t value) const
+    {
+        HostPlatform::WriteRegister(m_reg, value);
+        return *this;
+    }
+
+    const HostRegister& operator|=(int value) const
+    {
+        return *this = static_cast<uint8_t>(*this | value);
+    }
+
+    const HostRegister& operator&=(int value) const
+    {
+        return *this = static_cast<uint8_t>(*this & value);
+    }
+
+    const HostRegister& operator^=(int value) const
+    {
+        return *this = static_cast<uint8_t>(*this ^ value);
+    }
+
+private:
+    uint8_t m_reg;
+};
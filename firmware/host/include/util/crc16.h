@@ -0,0 +1,50 @@
+//
+// crc16.h
+// Copyright (C) 2018 Marius Greuel
+// SPDX-License-Identifier: GPL-3.0-or-later
+//
+
+// The C equivalents of the avr-libc CRC functions, as given in its documentation.
+
+#pragma once
+#include <stdint.h>
+
+inline uint16_t _crc16_update(uint16_t crc, uint8_t data)
+{
+    crc ^= data;
+    for (uint8_t i = 0; i < 8; i++)
+    {
+        crc = (crc & 1) != 0 ? (crc >> 1) ^ 0xA001 : crc >> 1;
+    }
+
+    return crc;
+}
+
+inline uint16_t _crc_xmodem_update(uint16_t crc, uint8_t data)
+{
+    crc ^= static_cast<uint16_t>(data) << 8;
+    for (uint8_t i = 0; i < 8; i++)
+    {
+        crc = (crc & 0x8000) != 0 ? (crc << 1) ^ 0x1021 : crc << 1;
+    }
+
+    return crc;
+}
+
+inline uint16_t _crc_ccitt_update(uint16_t crc, uint8_t data)
+{
+    data ^= static_cast<uint8_t>(crc);
+    data ^= data << 4;
+    return ((static_cast<uint16_t>(data) << 8) | (crc >> 8)) ^ static_cast<uint8_t>(data >> 4) ^ (static_cast<uint16_t>(data) << 3);
+}
+
+inline uint8_t _crc_ibutton_update(uint8_t crc, uint8_t data)
+{
+    crc ^= data;
+    for (uint8_t i = 0; i < 8; i++)
+    {
+        crc = (crc & 1) != 0 ? (crc >> 1) ^ 0x8C : crc >> 1;
+    }
+
+    return crc;
+}
@@ -0,0 +1,16 @@
+//
+// delay.h
+// Copyright (C) 2018 Marius Greuel
+// SPDX-License-Identifier: GPL-3.0-or-later
+//
+
+#pragma once
+
+// Busy waits take no virtual time.
+inline void _delay_us(double /* us */)
+{
+}
+
+inline void _delay_ms(double /* ms */)
+{
+}
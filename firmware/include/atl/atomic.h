@@ -0,0 +1,96 @@
+//
+// atomic.h
+// Copyright (C) 2018 Marius Greuel
+// SPDX-License-Identifier: GPL-3.0-or-later
+//
+
+#pragma once
+#include <atl/compiler.h>
+#include <stdint.h>
+
+namespace atl
+{
+    // Variables shared with an interrupt handler are declared without volatile,
+    // so the handler keeps them in registers. The other side accesses them
+    // through these helpers instead.
+
+    // The AVR reads and writes single bytes atomically.
+    template<typename T>
+    inline T AtomicLoad(const T& variable)
+    {
+        static_assert(sizeof(T) == 1, "Use ReadConsistent() or a SeqLock for larger types");
+        return *static_cast<const volatile T*>(&variable);
+    }
+
+    template<typename T>
+    inline void AtomicStore(T& variable, T value)
+    {
+        static_assert(sizeof(T) == 1, "Use ReadConsistent() or a SeqLock for larger types");
+        *static_cast<volatile T*>(&variable) = value;
+    }
+
+    // Reads a multi-byte variable without disabling interrupts, by reading it
+    // until two reads in a row agree. The writer must not be interrupted by the
+    // reader, and the value must change rarely compared with the time to read it,
+    // e.g. a time stamp or a counter.
+    template<typename T>
+    inline T ReadConsistent(const T& variable)
+    {
+        const volatile T& source = *static_cast<const volatile T*>(&variable);
+        T value = source;
+        for (;;)
+        {
+            T check = source;
+            if (check == value)
+                return value;
+
+            value = check;
+        }
+    }
+
+    // Sequence lock for data that one writer updates and readers copy with
+    // interrupts enabled. The writer must not be interrupted by a reader, i.e. it
+    // runs in an interrupt handler or holds an AutoLock between WriteBegin() and
+    // WriteEnd(). A reader copies the data and retries if a write came in between:
+    //
+    //     uint8_t sequence;
+    //     do
+    //     {
+    //         sequence = m_lock.ReadBegin();
+    //         ...copy...
+    //     } while (m_lock.ReadRetry(sequence));
+    //
+    // With double-buffered data, only the buffer switch needs to be bracketed:
+    // the writer refills the buffer a reader copies only after the next switch.
+    class SeqLock
+    {
+    public:
+        void WriteBegin()
+        {
+            m_sequence++;
+            ATL_MEMORY_BARRIER();
+        }
+
+        void WriteEnd()
+        {
+            ATL_MEMORY_BARRIER();
+            m_sequence++;
+        }
+
+        uint8_t ReadBegin() const
+        {
+            uint8_t sequence = m_sequence;
+            ATL_MEMORY_BARRIER();
+            return sequence;
+        }
+
+        bool ReadRetry(uint8_t sequence) const
+        {
+            ATL_MEMORY_BARRIER();
+            return (sequence & 1) != 0 || m_sequence != sequence;
+        }
+
+    private:
+        volatile uint8_t m_sequence = 0;
+    };
+}
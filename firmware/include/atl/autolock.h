@@ -5,11 +5,15 @@
 //
 
 #pragma once
-#include <avr/interrupt.h>
 #include <stdint.h>
 
+#if defined(__AVR__)
+#include <avr/interrupt.h>
+#endif
+
 namespace atl
 {
+#if defined(__AVR__)
     class AutoLock
     {
     public:
@@ -26,4 +30,19 @@ namespace atl
     private:
         uint8_t m_oldSREG;
     };
+#else
+    // Host builds (e.g. replaying recorded signals through the decoders)
+    // have no interrupts, so there is nothing to lock.
+    class AutoLock
+    {
+    public:
+        AutoLock()
+        {
+        }
+
+        ~AutoLock()
+        {
+        }
+    };
+#endif
 }
@@ -12,6 +12,7 @@
 #define ATL_ATTRIBUTE_PACKED __attribute__((packed))
 #define ATL_ATTRIBUTE_ALWAYS_INLINE __attribute__((always_inline))
 #define ATL_ATTRIBUTE_OPTIMIZE_O2 __attribute__((optimize(2)))
+#define ATL_MEMORY_BARRIER() __asm__ __volatile__("" ::: "memory")
 #else
 #error Unsupported compiler
 #endif
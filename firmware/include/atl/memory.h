@@ -21,6 +21,13 @@ namespace atl
     class RamTraits
     {
     public:
+        // A constant array in this memory, e.g. a table generated at compile time
+        template<typename T, T... values>
+        struct Array
+        {
+            static const T m_data[sizeof...(values)];
+        };
+
         static uint8_t ReadUInt8(const uint8_t* buffer)
         {
             return *buffer;
@@ -65,6 +72,12 @@ namespace atl
     class ProgmemTraits
     {
     public:
+        template<typename T, T... values>
+        struct Array
+        {
+            static const T m_data[sizeof...(values)];
+        };
+
         static uint8_t ReadUInt8(const uint8_t* buffer)
         {
             return pgm_read_byte(buffer);
@@ -84,8 +97,21 @@ namespace atl
         {
             return pgm_read_float(buffer);
         }
+
+        // Also for function pointers, e.g. of a dispatch table
+        template<typename T>
+        static T ReadPointer(const T* buffer)
+        {
+            return reinterpret_cast<T>(pgm_read_ptr(buffer));
+        }
     };
 
+    template<typename T, T... values>
+    const T RamTraits::Array<T, values...>::m_data[sizeof...(values)] = { values... };
+
+    template<typename T, T... values>
+    const T ProgmemTraits::Array<T, values...>::m_data[sizeof...(values)] PROGMEM = { values... };
+
     class EepromTraits
     {
     public:
@@ -130,6 +156,25 @@ namespace atl
         }
     };
 
+    // The traits of a memory type, for code that is specialized per memory type
+    template<MemoryType memoryType>
+    class MemoryTraits;
+
+    template<>
+    class MemoryTraits<MemoryType::Ram> : public RamTraits
+    {
+    };
+
+    template<>
+    class MemoryTraits<MemoryType::Progmem> : public ProgmemTraits
+    {
+    };
+
+    template<>
+    class MemoryTraits<MemoryType::Eeprom> : public EepromTraits
+    {
+    };
+
     class Memory
     {
     public:
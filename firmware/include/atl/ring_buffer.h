@@ -0,0 +1,81 @@
+//
+// ring_buffer.h
+// Copyright (C) 2018 Marius Greuel
+// SPDX-License-Identifier: GPL-3.0-or-later
+//
+
+#pragma once
+#include <atl/compiler.h>
+#include <stdint.h>
+
+namespace atl
+{
+    // Lock-free queue for one producer and one consumer, e.g. an ISR and the main loop.
+    // The head and tail indices are single bytes, which the AVR reads and writes atomically.
+    // They run freely and are masked on access, so all slots are usable.
+    template<typename T, uint8_t size>
+    class RingBuffer
+    {
+        static_assert(size > 0 && size <= 128 && (size & (size - 1)) == 0, "Size must be a power of two up to 128");
+
+        static const uint8_t mask = size - 1;
+
+    public:
+        RingBuffer() = default;
+        RingBuffer(const RingBuffer&) = delete;
+        RingBuffer& operator=(const RingBuffer& other) = delete;
+
+    public:
+        bool IsEmpty() const
+        {
+            return m_head == m_tail;
+        }
+
+        bool IsFull() const
+        {
+            return GetCount() == size;
+        }
+
+        uint8_t GetCount() const
+        {
+            return static_cast<uint8_t>(m_head - m_tail);
+        }
+
+        // Producer side
+        bool Push(const T& value)
+        {
+            uint8_t head = m_head;
+            if (static_cast<uint8_t>(head - m_tail) == size)
+                return false;
+
+            m_buffer[head & mask] = value;
+            ATL_MEMORY_BARRIER();
+            m_head = head + 1;
+            return true;
+        }
+
+        // Consumer side
+        bool Pop(T& value)
+        {
+            uint8_t tail = m_tail;
+            if (m_head == tail)
+                return false;
+
+            value = m_buffer[tail & mask];
+            ATL_MEMORY_BARRIER();
+            m_tail = tail + 1;
+            return true;
+        }
+
+        // Consumer side, drops everything queued so far
+        void Clear()
+        {
+            m_tail = m_head;
+        }
+
+    private:
+        T m_buffer[size];
+        volatile uint8_t m_head = 0;
+        volatile uint8_t m_tail = 0;
+    };
+}
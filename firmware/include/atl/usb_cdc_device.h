@@ -5,12 +5,23 @@
 //
 
 #pragma once
+#include <atl/autolock.h>
+#include <atl/ring_buffer.h>
 #include <atl/usb_cdc_spec.h>
 #include <atl/usb_device.h>
 
 namespace atl
 {
-    template<typename T>
+    // What WriteData() does when the transmit buffer is full
+    enum class CdcTxPolicy : uint8_t
+    {
+        DropNewest,
+        OverwriteOldest,
+    };
+
+    // Writes go to a RAM buffer and never wait for the host.
+    // The buffer is sent from OnEventStartOfFrame() via Flush().
+    template<typename T, CdcTxPolicy txPolicy = CdcTxPolicy::DropNewest, uint8_t txBufferSize = 128>
     class UsbCdcDeviceT : public UsbDeviceT<T>
     {
         static const uint8_t acmInterface = 0;
@@ -45,7 +56,9 @@ namespace atl
     public:
         void Open()
         {
-            m_flushRequired = false;
+            AutoLock lock;
+            m_txBuffer.Clear();
+            m_isLastPacketFull = false;
         }
 
         void Close()
@@ -81,24 +94,63 @@ namespace atl
             endpoint.ReadData(buffer, size);
         }
 
+        uint8_t GetWriteSpace() const
+        {
+            return IsOpen() ? txBufferSize - m_txBuffer.GetCount() : 0;
+        }
+
         void WriteData(const void* buffer, size_t size, MemoryType memoryType = MemoryType::Ram)
         {
             if (IsOpen())
             {
-                m_flushRequired = false;
-                UsbSaveInEndpoint endpoint(txEndpoint);
-                endpoint.WriteData(buffer, size, memoryType);
-                m_flushRequired = true;
+                const uint8_t* data = static_cast<const uint8_t*>(buffer);
+                for (size_t i = 0; i < size; i++)
+                {
+                    uint8_t ch = Memory::ReadUInt8(data + i, memoryType);
+                    if (!m_txBuffer.Push(ch) && txPolicy == CdcTxPolicy::OverwriteOldest)
+                    {
+                        AutoLock lock;
+                        uint8_t oldest;
+                        m_txBuffer.Pop(oldest);
+                        m_txBuffer.Push(ch);
+                    }
+                }
             }
         }
 
+        // Moves buffered data into whichever endpoint banks are free, without waiting.
+        // Called once per frame from OnEventStartOfFrame().
         void Flush()
         {
-            if (m_flushRequired)
+            if ((m_txBuffer.IsEmpty() && !m_isLastPacketFull) || !base::IsConfigured())
+                return;
+
+            UsbSaveEndpoint endpoint(txEndpoint);
+            if (m_txBuffer.IsEmpty())
+            {
+                // The last frame ended the burst with a full packet, so the host may still wait
+                // for more data of the transfer. A zero-length packet ends the transfer.
+                if (base::IsReadWriteAllowed())
+                {
+                    base::SendIn();
+                    m_isLastPacketFull = false;
+                }
+
+                return;
+            }
+
+            while (!m_txBuffer.IsEmpty() && base::IsReadWriteAllowed())
             {
-                UsbSaveInEndpoint endpoint(txEndpoint);
-                endpoint.CompleteTransfer(true);
-                m_flushRequired = false;
+                uint8_t count = 0;
+                uint8_t ch;
+                while (count < txEndpointSize && m_txBuffer.Pop(ch))
+                {
+                    base::WriteByte(ch);
+                    count++;
+                }
+
+                base::SendIn();
+                m_isLastPacketFull = count == txEndpointSize;
             }
         }
 
@@ -119,7 +171,7 @@ namespace atl
         void ConfigureEndpoints()
         {
             base::ConfigureEndpoint(acmEndpoint, base::EndpointType::Interrupt, base::EndpointDirection::In, acmEndpointSize, base::EndpointBanks::One);
-            base::ConfigureEndpoint(txEndpoint, base::EndpointType::Bulk, base::EndpointDirection::In, txEndpointSize, base::EndpointBanks::One);
+            base::ConfigureEndpoint(txEndpoint, base::EndpointType::Bulk, base::EndpointDirection::In, txEndpointSize, base::EndpointBanks::Two);
             base::ConfigureEndpoint(rxEndpoint, base::EndpointType::Bulk, base::EndpointDirection::Out, rxEndpointSize, base::EndpointBanks::One);
         }
 
@@ -283,6 +335,7 @@ namespace atl
     private:
         volatile CdcLineCoding m_lineCoding = { 57600, 0, 0, 0 };
         volatile uint8_t m_controlLineState = 0;
-        volatile bool m_flushRequired = false;
+        RingBuffer<uint8_t, txBufferSize> m_txBuffer;
+        bool m_isLastPacketFull = false;
     };
 }
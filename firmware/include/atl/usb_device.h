@@ -490,8 +490,8 @@ namespace atl
 
             for (uint8_t i = 0; i < chars; i++)
             {
-                endpoint.WriteData(string + i, sizeof(char), memoryType);
-                endpoint.WriteByte(0);
+                uint8_t utf16[] = { Memory::ReadUInt8(reinterpret_cast<const uint8_t*>(string + i), memoryType), 0 };
+                endpoint.WriteData(utf16, sizeof(utf16));
             }
 
             return MapStatus(endpoint.CompleteTransfer());
@@ -17,6 +17,12 @@
 #endif
 #endif
 
+// The size of the control endpoint, 8, 16, 32, or 64 bytes.
+// A larger endpoint takes fewer packets for descriptors and reports.
+#ifndef ATL_USB_CONTROL_ENDPOINT_SIZE
+#define ATL_USB_CONTROL_ENDPOINT_SIZE 8
+#endif
+
 #if defined(__AVR_ATmega8U2__) || defined(__AVR_ATmega16U2__) || defined(__AVR_ATmega32U2__) || defined(__AVR_AT90USB82__) || defined(__AVR_AT90USB162__)
 #define ATL_USB_SERIES2 1
 #elif defined(__AVR_ATmega16U4__) || defined(__AVR_ATmega32U4__)
@@ -42,7 +48,7 @@ namespace atl
         static const uint8_t EndpointMask = 0x7F;
         static const uint8_t AddressMask = 0x7F;
         static const uint8_t ControlEndpoint = 0;
-        static const uint8_t DefaultControlEndpointSize = 8;
+        static const uint8_t DefaultControlEndpointSize = ATL_USB_CONTROL_ENDPOINT_SIZE;
 
         enum class EndpointType : uint8_t
         {
@@ -531,11 +537,26 @@ namespace atl
             UECFG1X = uecfg1x;
         }
 
+        // Frees the memory of an endpoint, so it can be configured with a different size or bank count.
+        // Endpoint memory is allocated in endpoint order, so this only works for the highest endpoint.
+        static void ReleaseEndpoint(uint8_t endpoint)
+        {
+            SelectEndpoint(endpoint);
+            DisableEndpoint();
+            UECFG1X &= ~_BV(ALLOC);
+        }
+
         static bool IsEndpointConfigured()
         {
             return (UESTA0X & _BV(CFGOK)) != 0;
         }
 
+        // The banks of the selected endpoint that hold data, for an IN endpoint those the host has not read yet
+        static uint8_t GetBusyBanks()
+        {
+            return UESTA0X & (_BV(NBUSYBK1) | _BV(NBUSYBK0));
+        }
+
         static void ResetEndpoint(uint8_t endpoint)
         {
             UERST = _BV(endpoint);
@@ -552,6 +573,12 @@ namespace atl
             UERST = 0;
         }
 
+        // The size of the selected endpoint, from its configuration
+        static uint16_t GetSelectedEndpointSize()
+        {
+            return 8 << ((UECFG1X >> EPSIZE0) & 0x07);
+        }
+
         static uint8_t GetEndpointByteCount8()
         {
             return UEBCLX;
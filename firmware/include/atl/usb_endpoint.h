@@ -127,6 +127,34 @@ namespace atl
         {
             return GetContext().cancel || (udint & ((1 << EORSTI) | (1 << SUSPI))) != 0;
         }
+
+    protected:
+        // Copies a packet's worth of bytes to the FIFO, with the memory type
+        // dispatched once per packet instead of once per byte.
+        template<MemoryType memoryType>
+        static const uint8_t* WriteFifo(const uint8_t* data, uint16_t count)
+        {
+            for (; count > 0; count--)
+            {
+                UsbDriver::WriteByte(MemoryTraits<memoryType>::ReadUInt8(data));
+                data++;
+            }
+
+            return data;
+        }
+
+        static const uint8_t* WriteFifo(const uint8_t* data, uint16_t count, MemoryType memoryType)
+        {
+            switch (memoryType)
+            {
+            case MemoryType::Progmem:
+                return WriteFifo<MemoryType::Progmem>(data, count);
+            case MemoryType::Eeprom:
+                return WriteFifo<MemoryType::Eeprom>(data, count);
+            default:
+                return WriteFifo<MemoryType::Ram>(data, count);
+            }
+        }
     };
 
     class UsbInEndpoint : protected UsbEndpoint
@@ -165,14 +193,13 @@ namespace atl
                     return status;
                 }
 
-                while (bytesToTransmit > 0 && IsReadWriteAllowed())
-                {
-                    UsbDriver::WriteByte(Memory::ReadUInt8(data, memoryType));
-                    data++;
-                    bytesToTransmit--;
-                }
+                // The bank may hold the bytes of a previous call that did not fill it
+                uint16_t bytesFree = GetSelectedEndpointSize() - GetEndpointByteCount8();
+                uint16_t bytesToCopy = bytesToTransmit < bytesFree ? bytesToTransmit : bytesFree;
+                data = WriteFifo(data, bytesToCopy, memoryType);
+                bytesToTransmit -= bytesToCopy;
 
-                if (!IsReadWriteAllowed())
+                if (bytesToCopy == bytesFree)
                 {
                     SendIn();
                     m_flushRequired = false;
@@ -297,15 +324,16 @@ namespace atl
                 }
 
                 uint8_t bytesInEndpoint = GetEndpointByteCount8();
-
-                while (bytesToTransmit > 0 && bytesInEndpoint < endpointSize)
+                uint8_t bytesToCopy = endpointSize - bytesInEndpoint;
+                if (bytesToCopy > bytesToTransmit)
                 {
-                    UsbDriver::WriteByte(Memory::ReadUInt8(data, memoryType));
-                    data++;
-                    bytesToTransmit--;
-                    bytesInEndpoint++;
+                    bytesToCopy = static_cast<uint8_t>(bytesToTransmit);
                 }
 
+                data = WriteFifo(data, bytesToCopy, memoryType);
+                bytesToTransmit -= bytesToCopy;
+                bytesInEndpoint += bytesToCopy;
+
                 if (bytesInEndpoint >= endpointSize)
                 {
                     SendControlIn();
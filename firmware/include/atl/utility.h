@@ -0,0 +1,29 @@
+//
+// utility.h
+// Copyright (C) 2018 Marius Greuel
+// SPDX-License-Identifier: GPL-3.0-or-later
+//
+
+#pragma once
+#include <stdint.h>
+
+namespace atl
+{
+    // Compile-time list of indices, for expanding tables from a parameter pack.
+    template<uint8_t... index>
+    struct IndexSequence
+    {
+    };
+
+    // MakeIndexSequence<count>::Type is IndexSequence<0, 1, ..., count - 1>.
+    template<uint8_t count, uint8_t... index>
+    struct MakeIndexSequence : MakeIndexSequence<count - 1, count - 1, index...>
+    {
+    };
+
+    template<uint8_t... index>
+    struct MakeIndexSequence<0, index...>
+    {
+        using Type = IndexSequence<index...>;
+    };
+}
@@ -0,0 +1,16 @@
+//
+// decoder_error.h
+// Copyright (C) 2018 Marius Greuel
+// SPDX-License-Identifier: GPL-3.0-or-later
+//
+
+#pragma once
+#include <stdint.h>
+
+// Reason passed to a decoder's OnError() hook.
+enum class DecoderError : uint8_t
+{
+    Checksum,
+    ShortFrame,
+    LongFrame,
+};
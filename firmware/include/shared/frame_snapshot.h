@@ -0,0 +1,27 @@
+//
+// frame_snapshot.h
+// Copyright (C) 2018 Marius Greuel
+// SPDX-License-Identifier: GPL-3.0-or-later
+//
+
+#pragma once
+#include <stdint.h>
+
+// A consistent copy of the last frame received by a decoder.
+// Pulse widths are fixed point, in 1/16us, which holds a Timer1 tick at 16 MHz and clk/1,
+// and saturate at 0xFFFF. Channels past m_channelCount are zero.
+// The time is the capture time of the frame, in extended timer ticks.
+struct FrameSnapshot
+{
+    static const uint8_t maxChannelCount = 16;
+    static const uint8_t fractionBits = 4;
+
+    static uint16_t PulseWidthToUs(uint16_t pulseWidth)
+    {
+        return pulseWidth >> fractionBits;
+    }
+
+    uint32_t m_time;
+    uint8_t m_channelCount;
+    uint16_t m_channelPulseWidth[maxChannelCount];
+};
@@ -5,8 +5,18 @@
 //
 
 #pragma once
+#include <atl/atomic.h>
+#include <atl/autolock.h>
+#include <shared/decoder_error.h>
+#include <shared/frame_snapshot.h>
+#include <shared/pcm_symbol_table.h>
 #include <stdint.h>
 
+// Multiplex PCM decoder.
+// The timer policy provides Initialize(), UsToTicks()/TicksToUs() and the TableMemory
+// traits for the symbol table, so the decoder does not depend on the AVR hardware.
+// Edge times are timer ticks extended to 32 bits. OnFrameReceived() gets the time of
+// the falling edge that completes the frame.
 template<typename T, typename timer>
 class PcmReceiverT
 {
@@ -15,6 +25,10 @@ class PcmReceiverT
     static const uint8_t maxChannelCount = 10;
     static const uint8_t timeoutMs = 100;
 
+    static_assert(maxChannelCount <= FrameSnapshot::maxChannelCount, "FrameSnapshot too small");
+
+    using SymbolTable = PcmSymbolTableT<timer>;
+
 public:
     void Initialize()
     {
@@ -25,86 +39,142 @@ public:
     void Reset()
     {
         m_state = State::WaitingForSync;
+        m_frameLock.WriteBegin();
         m_currentBank = 0;
         m_channelCount = 0;
+        m_frameLock.WriteEnd();
         m_isReceiving = false;
         m_hasNewData = false;
     }
 
-    void RunTask()
+    // Checks the timeout against a deadline, called from the main loop
+    // with the current time in milliseconds.
+    void RunTask(uint16_t time)
     {
-        if (m_timeoutCounter < timeoutMs)
+        atl::AutoLock lock;
+        if (m_frameReceived)
         {
-            m_timeoutCounter++;
+            m_frameReceived = false;
+            m_timeoutDeadline = time + timeoutMs;
         }
-        else
+        else if (static_cast<int16_t>(time - m_timeoutDeadline) >= 0)
         {
-            m_timeoutCounter = 0;
+            m_timeoutDeadline = time + timeoutMs;
+            if (m_isReceiving)
+            {
+                static_cast<T*>(this)->OnTimeout();
+            }
+
             Reset();
         }
     }
 
     bool IsReceiving() const
     {
-        return m_isReceiving;
+        return atl::AtomicLoad(m_isReceiving);
     }
 
     bool HasNewData() const
     {
-        return m_hasNewData;
+        return atl::AtomicLoad(m_hasNewData);
     }
 
     void ClearNewData()
     {
-        m_hasNewData = false;
+        atl::AtomicStore(m_hasNewData, false);
     }
 
     uint8_t GetChannelCount() const
     {
-        return m_channelCount;
+        return atl::AtomicLoad(m_channelCount);
     }
 
     uint8_t GetChannelData(uint8_t channel) const
     {
-        if (channel >= m_channelCount)
-            return 0x80;
+        uint8_t data;
+        uint8_t sequence;
+        do
+        {
+            sequence = m_frameLock.ReadBegin();
+            data = channel < m_channelCount ? ~m_channelData[m_currentBank ^ 1][channel] : 0x80;
+        } while (m_frameLock.ReadRetry(sequence));
 
-        return ~m_channelData[m_currentBank ^ 1][channel];
+        return data;
     }
 
     uint16_t GetChannelPulseWidth(uint8_t channel) const
     {
-        uint16_t value = GetChannelData(channel);
-        return 1050 + 138 * value / 0x20;
+        return DataToUs(GetChannelData(channel));
+    }
+
+    void GetFrame(FrameSnapshot& frame) const
+    {
+        uint8_t channelCount;
+        uint8_t channelData[maxChannelCount];
+        uint8_t sequence;
+        do
+        {
+            sequence = m_frameLock.ReadBegin();
+            frame.m_time = m_frameTime;
+            channelCount = m_channelCount;
+            auto data = m_channelData[m_currentBank ^ 1];
+            for (uint8_t i = 0; i < channelCount; i++)
+            {
+                channelData[i] = data[i];
+            }
+        } while (m_frameLock.ReadRetry(sequence));
+
+        frame.m_channelCount = channelCount;
+        for (uint8_t i = 0; i < FrameSnapshot::maxChannelCount; i++)
+        {
+            frame.m_channelPulseWidth[i] = i < channelCount ? DataToPulseWidth(~channelData[i]) : 0;
+        }
     }
 
-    void OnInputEdge(uint16_t time, bool risingEdge)
+    void OnInputEdge(uint32_t time, bool risingEdge)
     {
         ProcessEdge(time, risingEdge);
     }
 
+    // Drops the frame in progress, e.g. after lost edges.
+    void DiscardFrame()
+    {
+        m_state = State::WaitingForSync;
+    }
+
 protected:
     void OnSyncDetected()
     {
     }
 
-    void OnFrameReceived()
+    void OnFrameReceived(uint32_t)
     {
     }
 
-    void OnError()
+    void OnError(DecoderError)
+    {
+    }
+
+    void OnTimeout()
     {
     }
 
 private:
-    void ProcessEdge(uint16_t time, bool risingEdge)
+    void ProcessEdge(uint32_t time, bool risingEdge)
     {
-        uint16_t diff = time - m_timeOfLastFallingEdge;
+        // A long gap must not wrap to a short symbol, at clk/1 the timer period is only 4ms
+        uint32_t elapsed = time - m_timeOfLastFallingEdge;
+        uint16_t diff = elapsed <= 0xFFFF ? static_cast<uint16_t>(elapsed) : 0xFFFF;
 
         if (risingEdge)
         {
             if (diff >= timer::UsToTicks(minSyncPulseWidthUs))
             {
+                if (m_state == State::ReceivingData)
+                {
+                    static_cast<T*>(this)->OnError(DecoderError::ShortFrame);
+                }
+
                 m_state = State::SyncDetected;
                 static_cast<T*>(this)->OnSyncDetected();
             }
@@ -119,54 +189,56 @@ private:
                 m_lastBits = 3;
                 m_bitCount = 0;
                 m_currentData = 0;
+                m_checksum = 3;
                 m_currentChannel = 0;
             }
             else if (m_state == State::ReceivingData)
             {
-                uint8_t symbol = GetSymbol(diff);
-                uint8_t bits = symbol - (3 - m_lastBits);
-                if (bits <= 3)
+                // Symbols are relative to the previous bit pair, out-of-range values wrap above 3
+                uint8_t bits = SymbolTable::GetSymbol(diff) + m_lastBits - 3;
+                if (bits > 3)
+                    return;
+
+                m_lastBits = bits;
+
+                uint8_t bitCount = m_bitCount;
+                if (bitCount < 8)
                 {
-                    if (m_bitCount >= 8)
+                    m_currentData = (m_currentData << 2) | bits;
+                    m_checksum ^= bits;
+                    m_bitCount = bitCount + 2;
+
+                    if (m_currentChannel == 8 && bitCount == 2)
                     {
-                        if (CalculateChecksum(m_currentData) == bits)
-                        {
-                            uint8_t currentChannel = m_currentChannel;
-                            if (currentChannel < maxChannelCount)
-                            {
-                                m_channelData[m_currentBank][currentChannel] = m_currentData;
-                                m_currentChannel = currentChannel + 1;
-                            }
-
-                            m_bitCount = 0;
-                            m_currentData = 0;
-                        }
-                        else
-                        {
-                            m_state = State::WaitingForSync;
-                            static_cast<T*>(this)->OnError();
-                        }
+                        ProcessFrame(time);
+                        m_state = State::WaitingForSync;
                     }
-                    else
+                }
+                else if (bits == m_checksum)
+                {
+                    uint8_t currentChannel = m_currentChannel;
+                    if (currentChannel < maxChannelCount)
                     {
-                        m_bitCount += 2;
-                        m_currentData = (m_currentData << 2) | bits;
-
-                        if (m_currentChannel == 8 && m_bitCount == 4)
-                        {
-                            ProcessFrame();
-                            m_state = State::WaitingForSync;
-                        }
+                        m_channelData[m_currentBank][currentChannel] = m_currentData;
+                        m_currentChannel = currentChannel + 1;
                     }
 
-                    m_lastBits = bits;
+                    m_bitCount = 0;
+                    m_currentData = 0;
+                    m_checksum = 3;
+                }
+                else
+                {
+                    m_state = State::WaitingForSync;
+                    static_cast<T*>(this)->OnError(DecoderError::Checksum);
                 }
             }
         }
     }
 
-    void ProcessFrame()
+    void ProcessFrame(uint32_t time)
     {
+        atl::AutoLock lock;
         if (m_currentData == 0xC)
         {
             // Value 6 and 7 contains channel 6 and 7.
@@ -180,82 +252,26 @@ private:
             m_channelData[m_currentBank][7] = m_channelData[m_currentBank ^ 1][7];
         }
 
-        m_timeoutCounter = 0;
+        m_frameReceived = true;
+        m_frameLock.WriteBegin();
         m_currentBank ^= 1;
         m_channelCount = m_currentChannel + 2;
+        m_frameTime = time;
+        m_frameLock.WriteEnd();
         m_isReceiving = true;
         m_hasNewData = true;
-        static_cast<T*>(this)->OnFrameReceived();
+        static_cast<T*>(this)->OnFrameReceived(time);
     }
 
-    static uint8_t GetSymbol(uint16_t width)
+    static uint16_t DataToUs(uint8_t value)
     {
-        static const uint16_t S0 = 880;
-        static const uint16_t S1 = 1020;
-        static const uint16_t S2 = 1160;
-        static const uint16_t S3 = 1300;
-        static const uint16_t S4 = 1440;
-        static const uint16_t S5 = 1580;
-        static const uint16_t S6 = 1720;
-        static const uint16_t W = 140 / 2;
-
-        if (width < timer::UsToTicks(S3 - W))
-        {
-            if (width < timer::UsToTicks(S1 - W))
-            {
-                if (width < timer::UsToTicks(S0 - W))
-                {
-                    return 7;
-                }
-                else
-                {
-                    return 0;
-                }
-
-                return 0;
-            }
-            else
-            {
-                if (width < timer::UsToTicks(S2 - W))
-                {
-                    return 1;
-                }
-                else
-                {
-                    return 2;
-                }
-            }
-        }
-        else
-        {
-            if (width < timer::UsToTicks(S5 - W))
-            {
-                if (width < timer::UsToTicks(S4 - W))
-                {
-                    return 3;
-                }
-                else
-                {
-                    return 4;
-                }
-            }
-            else
-            {
-                if (width < timer::UsToTicks(S6 - W))
-                {
-                    return 5;
-                }
-                else
-                {
-                    return 6;
-                }
-            }
-        }
+        return 1050 + 138 * static_cast<uint16_t>(value) / 0x20;
     }
 
-    static uint8_t CalculateChecksum(uint8_t value)
+    // The same in the fixed point of FrameSnapshot
+    static uint16_t DataToPulseWidth(uint8_t value)
     {
-        return (3 ^ (value >> 6) ^ (value >> 4) ^ (value >> 2) ^ (value >> 0)) & 3;
+        return static_cast<uint16_t>(((1050 * 0x20 + 138 * static_cast<uint32_t>(value)) << FrameSnapshot::fractionBits) / 0x20);
     }
 
 private:
@@ -266,17 +282,22 @@ private:
         ReceivingData,
     };
 
-    volatile uint8_t m_channelData[2][maxChannelCount] = {};
-    volatile uint16_t m_timeOfLastFallingEdge = 0;
-    volatile State m_state = State::WaitingForSync;
-    volatile uint8_t m_lastBits = 3;
-    volatile uint8_t m_bitCount = 0;
-    volatile uint8_t m_currentData = 0;
-    volatile uint8_t m_currentBank = 0;
-    volatile uint8_t m_currentChannel = 0;
-    volatile uint8_t m_channelCount = 0;
-    volatile uint8_t m_timeoutCounter = 0;
-    volatile bool m_risingEdge = false;
-    volatile bool m_isReceiving = false;
-    volatile bool m_hasNewData = false;
+    // Not volatile, so the decoder keeps its state in registers. Other contexts go
+    // through the atomic helpers, m_frameLock, or an AutoLock.
+    uint8_t m_channelData[2][maxChannelCount] = {};
+    uint32_t m_timeOfLastFallingEdge = 0;
+    uint32_t m_frameTime = 0;
+    State m_state = State::WaitingForSync;
+    uint8_t m_lastBits = 3;
+    uint8_t m_bitCount = 0;
+    uint8_t m_currentData = 0;
+    uint8_t m_checksum = 3;
+    uint8_t m_currentBank = 0;
+    uint8_t m_currentChannel = 0;
+    uint8_t m_channelCount = 0;
+    uint16_t m_timeoutDeadline = 0;
+    bool m_frameReceived = false;
+    bool m_isReceiving = false;
+    bool m_hasNewData = false;
+    atl::SeqLock m_frameLock;
 };
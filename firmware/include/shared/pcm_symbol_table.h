@@ -0,0 +1,106 @@
+//
+// pcm_symbol_table.h
+// Copyright (C) 2018 Marius Greuel
+// SPDX-License-Identifier: GPL-3.0-or-later
+//
+
+#pragma once
+#include <atl/utility.h>
+#include <stdint.h>
+
+// Multiplex PCM symbol widths, 140us apart.
+// Symbols 0..6 are 880us..1720us, 7 is anything shorter.
+template<typename timer>
+class PcmSymbolsT
+{
+    static const uint16_t S0 = 880;
+    static const uint16_t S1 = 1020;
+    static const uint16_t S2 = 1160;
+    static const uint16_t S3 = 1300;
+    static const uint16_t S4 = 1440;
+    static const uint16_t S5 = 1580;
+    static const uint16_t S6 = 1720;
+    static const uint16_t W = 140 / 2;
+    static const uint8_t maxTableSize = 128;
+
+public:
+    static const uint8_t shortSymbol = 7;
+    static const uint8_t longestSymbol = 6;
+
+    static constexpr uint8_t Classify(uint16_t width)
+    {
+        return
+            width < timer::UsToTicks(S0 - W) ? shortSymbol :
+            width < timer::UsToTicks(S1 - W) ? 0 :
+            width < timer::UsToTicks(S2 - W) ? 1 :
+            width < timer::UsToTicks(S3 - W) ? 2 :
+            width < timer::UsToTicks(S4 - W) ? 3 :
+            width < timer::UsToTicks(S5 - W) ? 4 :
+            width < timer::UsToTicks(S6 - W) ? 5 :
+            longestSymbol;
+    }
+
+    // Width at which the next longer symbol starts.
+    static constexpr uint16_t GetUpperThreshold(uint8_t symbol)
+    {
+        return
+            symbol == shortSymbol ? timer::UsToTicks(S0 - W) :
+            symbol == longestSymbol ? 0xFFFF :
+            timer::UsToTicks(S1 - W + symbol * (S1 - S0));
+    }
+
+    // Smallest shift that fits all widths up to the last threshold into the table.
+    static constexpr uint8_t GetShift(uint8_t shift = 0)
+    {
+        return (timer::UsToTicks(S6 - W) >> shift) < maxTableSize ? shift : GetShift(shift + 1);
+    }
+
+    static const uint8_t shift = GetShift();
+    static const uint8_t tableSize = (timer::UsToTicks(S6 - W) >> shift) + 1;
+
+    static_assert((1 << shift) <= timer::UsToTicks(S1 - S0), "Table entry spans more than one threshold");
+};
+
+// Maps a pulse width to a symbol in constant time, with the same result as Classify().
+// The table is generated at compile time for the timer's tick rate. Each entry holds the
+// symbol at its lower end; an entry is narrower than a symbol, so it contains at most
+// one threshold, which a single compare resolves.
+// The tables go to the timer policy's TableMemory, e.g. atl::ProgmemTraits on the AVR.
+template<typename timer, typename = typename atl::MakeIndexSequence<PcmSymbolsT<timer>::tableSize>::Type>
+class PcmSymbolTableT;
+
+template<typename timer, uint8_t... index>
+class PcmSymbolTableT<timer, atl::IndexSequence<index...>>
+{
+    using Symbols = PcmSymbolsT<timer>;
+    using Memory = typename timer::TableMemory;
+
+    using SymbolTable = typename Memory::template Array<uint8_t,
+        Symbols::Classify(static_cast<uint16_t>(index) << Symbols::shift)...>;
+
+    using UpperThresholdTable = typename Memory::template Array<uint16_t,
+        Symbols::GetUpperThreshold(0),
+        Symbols::GetUpperThreshold(1),
+        Symbols::GetUpperThreshold(2),
+        Symbols::GetUpperThreshold(3),
+        Symbols::GetUpperThreshold(4),
+        Symbols::GetUpperThreshold(5),
+        Symbols::GetUpperThreshold(6),
+        Symbols::GetUpperThreshold(7)>;
+
+public:
+    static uint8_t GetSymbol(uint16_t width)
+    {
+        uint16_t entry = width >> Symbols::shift;
+        if (entry >= Symbols::tableSize)
+            return Symbols::longestSymbol;
+
+        uint8_t symbol = Memory::ReadUInt8(&SymbolTable::m_data[entry]);
+        if (width >= Memory::ReadUInt16(&UpperThresholdTable::m_data[symbol]))
+        {
+            symbol = (symbol + 1) & 7;
+        }
+
+        return symbol;
+    }
+};
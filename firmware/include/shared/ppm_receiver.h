@@ -5,9 +5,17 @@
 //
 
 #pragma once
+#include <atl/atomic.h>
 #include <atl/autolock.h>
+#include <shared/decoder_error.h>
+#include <shared/frame_snapshot.h>
 #include <stdint.h>
 
+// PPM decoder.
+// The timer policy provides Initialize(), TCNT(), OCR() and the tick conversions
+// UsToTicks()/UsToTicks32()/TicksToUs(), so the decoder does not depend on the AVR hardware.
+// Edge times are timer ticks extended to 32 bits. OnFrameReceived() gets the time of
+// the edge that ends the last channel, the start of the sync pause.
 template<typename T, typename timer>
 class PpmReceiverT
 {
@@ -16,6 +24,8 @@ class PpmReceiverT
     static const uint8_t maxTimeoutCount = 50;
     static const uint16_t defaultSyncPulseWidthUs = 3500;
 
+    static_assert(maxChannelCount <= FrameSnapshot::maxChannelCount, "FrameSnapshot too small");
+
 public:
     using Timer = timer;
 
@@ -29,45 +39,54 @@ public:
     void Reset()
     {
         m_state = State::WaitingForSync;
+        m_frameLock.WriteBegin();
         m_currentBank = 0;
-        m_currentChannel = 0;
         m_channelCount = 0;
+        m_frameLock.WriteEnd();
+        m_currentChannel = 0;
         m_timeoutCount = maxTimeoutCount;
         m_hasNewData = false;
     }
 
     void SetMinSyncPulseWidth(uint16_t minSyncPulseWidthUs)
     {
-        m_minSyncPulseWidth = timer::UsToTicks(minSyncPulseWidthUs);
+        // At high timer rates, long sync pulses are limited to the timer period
+        uint32_t ticks = timer::UsToTicks32(minSyncPulseWidthUs);
+        atl::AutoLock lock;
+        m_minSyncPulseWidth = ticks <= 0xFFFF ? static_cast<uint16_t>(ticks) : 0xFFFF;
     }
 
     bool IsReceiving() const
     {
-        return m_timeoutCount < maxTimeoutCount;
+        return atl::AtomicLoad(m_timeoutCount) < maxTimeoutCount;
     }
 
     bool HasNewData() const
     {
-        return m_hasNewData;
+        return atl::AtomicLoad(m_hasNewData);
     }
 
     void ClearNewData()
     {
-        m_hasNewData = false;
+        atl::AtomicStore(m_hasNewData, false);
     }
 
     uint8_t GetChannelCount() const
     {
-        return m_channelCount;
+        return atl::AtomicLoad(m_channelCount);
     }
 
     uint16_t GetChannelTicks(uint8_t channel) const
     {
-        if (channel >= m_channelCount)
-            return 0;
+        uint16_t ticks;
+        uint8_t sequence;
+        do
+        {
+            sequence = m_frameLock.ReadBegin();
+            ticks = channel < m_channelCount ? m_pulseWidth[m_currentBank ^ 1][channel] : 0;
+        } while (m_frameLock.ReadRetry(sequence));
 
-        atl::AutoLock lock;
-        return m_pulseWidth[m_currentBank ^ 1][channel];
+        return ticks;
     }
 
     uint16_t GetChannelPulseWidth(uint8_t channel) const
@@ -79,9 +98,32 @@ public:
         return timer::TicksToUs(ticks);
     }
 
-    void OnInputEdge(uint16_t time)
+    void GetFrame(FrameSnapshot& frame) const
     {
-        timer::OCR() = time + m_minSyncPulseWidth;
+        uint8_t channelCount;
+        uint8_t sequence;
+        do
+        {
+            sequence = m_frameLock.ReadBegin();
+            frame.m_time = m_frameTime;
+            channelCount = m_channelCount;
+            uint8_t bank = m_currentBank ^ 1;
+            for (uint8_t i = 0; i < channelCount; i++)
+            {
+                frame.m_channelPulseWidth[i] = m_pulseWidth[bank][i];
+            }
+        } while (m_frameLock.ReadRetry(sequence));
+
+        frame.m_channelCount = channelCount;
+        for (uint8_t i = 0; i < FrameSnapshot::maxChannelCount; i++)
+        {
+            frame.m_channelPulseWidth[i] = i < channelCount ? TicksToPulseWidth(frame.m_channelPulseWidth[i]) : 0;
+        }
+    }
+
+    void OnInputEdge(uint32_t time)
+    {
+        StartSyncTimeout(time);
         ProcessEdge(time);
     }
 
@@ -90,19 +132,59 @@ public:
         ProcessSyncPause();
     }
 
+    // Deferred decoding: the edge ISR only starts the sync timeout,
+    // the main loop decodes the queued edges and sync pauses in order.
+    void StartSyncTimeout(uint32_t time)
+    {
+        timer::OCR() = static_cast<uint16_t>(time) + m_minSyncPulseWidth;
+    }
+
+    void OnDeferredEdge(uint32_t time)
+    {
+        ProcessEdge(time);
+    }
+
+    void OnDeferredSyncPause()
+    {
+        ProcessSyncPause();
+    }
+
+    // Drops the frame in progress, e.g. after lost edges.
+    void DiscardFrame()
+    {
+        m_state = State::WaitingForSync;
+    }
+
 protected:
     void OnSyncDetected()
     {
     }
 
-    void OnFrameReceived()
+    void OnFrameReceived(uint32_t)
+    {
+    }
+
+    void OnError(DecoderError)
+    {
+    }
+
+    void OnTimeout()
     {
     }
 
 private:
-    void ProcessEdge(uint16_t time)
+    // Keeps the fraction of a microsecond, see FrameSnapshot
+    static uint16_t TicksToPulseWidth(uint16_t ticks)
     {
-        uint16_t diff = time - m_timeOfLastEdge;
+        uint32_t pulseWidth = timer::TicksToUs32(static_cast<uint32_t>(ticks) << FrameSnapshot::fractionBits);
+        return pulseWidth <= 0xFFFF ? static_cast<uint16_t>(pulseWidth) : 0xFFFF;
+    }
+
+    void ProcessEdge(uint32_t time)
+    {
+        // Gaps past the 16-bit range are no channel, whatever they wrap to
+        uint32_t elapsed = time - m_timeOfLastEdge;
+        uint16_t diff = elapsed <= 0xFFFF ? static_cast<uint16_t>(elapsed) : 0xFFFF;
         m_timeOfLastEdge = time;
 
         State state = m_state;
@@ -118,29 +200,56 @@ private:
                 m_pulseWidth[m_currentBank][currentChannel] = diff;
                 m_currentChannel = currentChannel + 1;
             }
+            else
+            {
+                // Extra pulses are dropped, remember that the frame was too long
+                m_currentChannel = maxChannelCount + 1;
+            }
         }
     }
 
     void ProcessSyncPause()
     {
         uint8_t currentChannel = m_currentChannel;
+        if (currentChannel > maxChannelCount)
+        {
+            currentChannel = maxChannelCount;
+            static_cast<T*>(this)->OnError(DecoderError::LongFrame);
+        }
+
         if (currentChannel >= minChannelCount)
         {
+            atl::AutoLock lock;
+            m_frameLock.WriteBegin();
             m_currentBank ^= 1;
             m_channelCount = currentChannel;
+            m_frameTime = m_timeOfLastEdge;
+            m_frameLock.WriteEnd();
             m_timeoutCount = 0;
             m_hasNewData = true;
-            static_cast<T*>(this)->OnFrameReceived();
+            static_cast<T*>(this)->OnFrameReceived(m_timeOfLastEdge);
         }
         else
         {
+            if (currentChannel > 0)
+            {
+                static_cast<T*>(this)->OnError(DecoderError::ShortFrame);
+            }
+
             if (m_timeoutCount < maxTimeoutCount)
             {
                 m_timeoutCount++;
+                if (m_timeoutCount == maxTimeoutCount)
+                {
+                    static_cast<T*>(this)->OnTimeout();
+                }
             }
             else
             {
+                atl::AutoLock lock;
+                m_frameLock.WriteBegin();
                 m_channelCount = 0;
+                m_frameLock.WriteEnd();
             }
         }
 
@@ -157,13 +266,17 @@ private:
         ReceivingData,
     };
 
-    volatile uint16_t m_pulseWidth[2][maxChannelCount] = {};
-    volatile uint16_t m_minSyncPulseWidth = timer::UsToTicks(defaultSyncPulseWidthUs);
-    volatile uint16_t m_timeOfLastEdge = 0;
-    volatile State m_state = State::WaitingForSync;
-    volatile uint8_t m_currentBank = 0;
-    volatile uint8_t m_currentChannel = 0;
-    volatile uint8_t m_channelCount = 0;
-    volatile uint8_t m_timeoutCount = 0;
-    volatile bool m_hasNewData = false;
+    // Not volatile, so the decoder keeps its state in registers. Other contexts go
+    // through the atomic helpers, m_frameLock, or an AutoLock.
+    uint16_t m_pulseWidth[2][maxChannelCount] = {};
+    uint16_t m_minSyncPulseWidth = timer::UsToTicks(defaultSyncPulseWidthUs);
+    uint32_t m_timeOfLastEdge = 0;
+    uint32_t m_frameTime = 0;
+    State m_state = State::WaitingForSync;
+    uint8_t m_currentBank = 0;
+    uint8_t m_currentChannel = 0;
+    uint8_t m_channelCount = 0;
+    uint8_t m_timeoutCount = 0;
+    bool m_hasNewData = false;
+    atl::SeqLock m_frameLock;
 };
@@ -6,9 +6,10 @@
 
 #pragma once
 #include <avr/io.h>
+#include <shared/timer1_clock.h>
 #include <stdint.h>
 
-class PpmReceiverTimer1B
+class PpmReceiverTimer1B : public Timer1Clock
 {
 public:
     static void Initialize()
@@ -40,16 +41,4 @@ public:
     {
         return OCR1B;
     }
-
-    // clk/8 => 1.3824 ticks/us
-
-    static constexpr uint16_t TicksToUs(uint16_t value)
-    {
-        return static_cast<uint16_t>(static_cast<uint32_t>(value) * 80000 / (F_CPU / 100));
-    }
-
-    static constexpr uint16_t UsToTicks(uint16_t value)
-    {
-        return static_cast<uint16_t>(static_cast<uint32_t>(value) * (F_CPU / 100) / 80000);
-    }
 };
@@ -6,8 +6,17 @@
 
 #pragma once
 #include <stdint.h>
+#include <atl/atomic.h>
 #include <atl/autolock.h>
-
+#include <shared/decoder_error.h>
+#include <shared/frame_snapshot.h>
+
+// Multiplex SRXL decoder.
+// The timer policy provides Initialize(), TCNT(), OCR(), UsToTicks() and UsToTicks32(), and
+// the USART policy provides Initialize(baudrate), so the decoder does not
+// depend on the AVR hardware.
+// Byte times are timer ticks extended to 32 bits, taken when the byte is received.
+// OnFrameReceived() gets the time of the last byte of the frame.
 template<typename T, typename timer, typename usart>
 class SrxlReceiverT
 {
@@ -18,6 +27,9 @@ class SrxlReceiverT
     static const uint16_t syncPauseUs = 5000;
     static const uint8_t timeoutMs = 100;
 
+    static_assert(maxChannelCount <= FrameSnapshot::maxChannelCount, "FrameSnapshot too small");
+    static_assert(timer::UsToTicks32(syncPauseUs) <= 0xFFFF, "Sync pause does not fit the timer, use a larger prescaler");
+
     enum FrameStatus : uint8_t
     {
         Special = 0xF0,
@@ -39,93 +51,153 @@ public:
     void Reset()
     {
         m_state = State::WaitingForSync;
+        m_frameLock.WriteBegin();
         m_currentBank = 0;
+        m_frameLock.WriteEnd();
         m_bytesReceived = 0;
         m_isReceiving = false;
         m_hasNewData = false;
     }
 
-    void RunTask()
+    // Checks the timeout against a deadline, called from the main loop
+    // with the current time in milliseconds.
+    void RunTask(uint16_t time)
     {
-        if (m_timeoutCounter < timeoutMs)
+        atl::AutoLock lock;
+        if (m_frameReceived)
         {
-            m_timeoutCounter++;
+            m_frameReceived = false;
+            m_timeoutDeadline = time + timeoutMs;
         }
-        else
+        else if (static_cast<int16_t>(time - m_timeoutDeadline) >= 0)
         {
-            m_timeoutCounter = 0;
+            m_timeoutDeadline = time + timeoutMs;
+            if (m_isReceiving)
+            {
+                static_cast<T*>(this)->OnTimeout();
+            }
+
             Reset();
         }
     }
 
     bool IsReceiving() const
     {
-        return m_isReceiving;
+        return atl::AtomicLoad(m_isReceiving);
     }
 
     bool HasNewData() const
     {
-        return m_hasNewData;
+        return atl::AtomicLoad(m_hasNewData);
     }
 
     void ClearNewData()
     {
-        m_hasNewData = false;
+        atl::AtomicStore(m_hasNewData, false);
     }
 
     uint8_t GetChannelCount() const
     {
-        return m_channelCount;
+        return atl::AtomicLoad(m_channelCount);
     }
 
     uint16_t GetChannelPulseWidth(uint8_t channel) const
     {
-        if (channel >= m_channelCount)
-            return 0;
+        bool valid;
+        uint16_t value;
+        uint8_t sequence;
+        do
+        {
+            sequence = m_frameLock.ReadBegin();
+            valid = channel < m_channelCount;
+            value = valid ? GetUInt16(m_frame[m_currentBank ^ 1], 1 + channel * 2) : 0;
+        } while (m_frameLock.ReadRetry(sequence));
 
-        auto frame = m_frame[m_currentBank ^ 1];
-        auto index = 1 + channel * 2;
+        return valid ? DataToUs(value) : 0;
+    }
 
-        uint16_t value;
+    void GetFrame(FrameSnapshot& frame) const
+    {
+        uint8_t channelCount;
+        uint8_t sequence;
+        do
         {
-            atl::AutoLock lock;
-            value = GetUInt16(frame, index);
+            sequence = m_frameLock.ReadBegin();
+            frame.m_time = m_frameTime;
+            channelCount = m_channelCount;
+            auto data = m_frame[m_currentBank ^ 1];
+            for (uint8_t i = 0; i < channelCount; i++)
+            {
+                frame.m_channelPulseWidth[i] = GetUInt16(data, 1 + i * 2);
+            }
+        } while (m_frameLock.ReadRetry(sequence));
+
+        frame.m_channelCount = channelCount;
+        for (uint8_t i = 0; i < FrameSnapshot::maxChannelCount; i++)
+        {
+            frame.m_channelPulseWidth[i] = i < channelCount ? DataToPulseWidth(frame.m_channelPulseWidth[i]) : 0;
         }
+    }
+
+    void OnDataReceived(uint8_t ch, uint32_t time)
+    {
+        StartSyncTimeout();
+        AddByteToFrame(ch, time);
+    }
 
-        return DataToUs(value);
+    void OnOutputCompare()
+    {
+        ProcessSyncPause();
     }
 
-    void OnDataReceived(uint8_t ch)
+    // Deferred decoding: the receive ISR only starts the sync timeout,
+    // the main loop decodes the queued bytes and sync pauses in order.
+    void StartSyncTimeout()
     {
         timer::OCR() = timer::TCNT() + timer::UsToTicks(syncPauseUs);
-        AddByteToFrame(ch);
     }
 
-    void OnOutputCompare()
+    void OnDeferredData(uint8_t ch, uint32_t time)
+    {
+        AddByteToFrame(ch, time);
+    }
+
+    void OnDeferredSyncPause()
     {
         ProcessSyncPause();
     }
 
+    // Drops the frame in progress, e.g. after lost bytes.
+    void DiscardFrame()
+    {
+        m_state = State::WaitingForSync;
+    }
+
 protected:
     void OnSyncDetected()
     {
     }
 
-    void OnFrameReceived()
+    void OnFrameReceived(uint32_t)
+    {
+    }
+
+    void OnError(DecoderError)
     {
     }
 
-    void OnError()
+    void OnTimeout()
     {
     }
 
 private:
-    void AddByteToFrame(uint8_t ch)
+    void AddByteToFrame(uint8_t ch, uint32_t time)
     {
         if (m_state == State::SyncDetected)
         {
             m_state = State::ReceivingData;
             m_bytesReceived = 0;
+            m_crc = 0;
         }
 
         if (m_state == State::ReceivingData)
@@ -134,46 +206,62 @@ private:
             {
                 auto frame = m_frame[m_currentBank];
                 frame[m_bytesReceived++] = ch;
+                m_crc = UpdateCrc16(m_crc, ch);
 
                 if (frame[0] == headerV1 && m_bytesReceived == 1 + 12 * 2 + 2)
                 {
-                    ProcessFrame(frame, 12);
+                    ProcessFrame(12, time);
                 }
                 else if (frame[0] == headerV2 && m_bytesReceived == 1 + 16 * 2 + 2)
                 {
-                    ProcessFrame(frame, 16);
+                    ProcessFrame(16, time);
                 }
             }
+            else
+            {
+                m_state = State::WaitingForSync;
+                static_cast<T*>(this)->OnError(DecoderError::LongFrame);
+            }
         }
     }
 
     void ProcessSyncPause()
     {
+        if (m_state == State::ReceivingData)
+        {
+            static_cast<T*>(this)->OnError(DecoderError::ShortFrame);
+        }
+
         m_state = State::SyncDetected;
         static_cast<T*>(this)->OnSyncDetected();
     }
 
-    void ProcessFrame(const volatile uint8_t* frame, uint8_t channelCount)
+    void ProcessFrame(uint8_t channelCount, uint32_t time)
     {
-        uint16_t crc = GetUInt16(frame, m_bytesReceived - 2);
-        if (CalculateCrc16(frame, m_bytesReceived - 2) == crc)
+        // The CRC has been folded in byte by byte, including the trailing
+        // big-endian CRC field, which leaves a residue of zero for a valid frame.
+        if (m_crc == 0)
         {
-            m_timeoutCounter = 0;
+            atl::AutoLock lock;
+            m_frameReceived = true;
+            m_frameLock.WriteBegin();
             m_currentBank ^= 1;
             m_channelCount = channelCount;
+            m_frameTime = time;
+            m_frameLock.WriteEnd();
             m_isReceiving = true;
             m_hasNewData = true;
-            static_cast<T*>(this)->OnFrameReceived();
+            static_cast<T*>(this)->OnFrameReceived(time);
             m_state = State::SyncDetected;
         }
         else
         {
             m_state = State::WaitingForSync;
-            static_cast<T*>(this)->OnError();
+            static_cast<T*>(this)->OnError(DecoderError::Checksum);
         }
     }
 
-    static uint16_t GetUInt16(const volatile uint8_t* data, uint8_t index)
+    static uint16_t GetUInt16(const uint8_t* data, uint8_t index)
     {
         return (data[index] << 8) | data[index + 1];
     }
@@ -183,35 +271,19 @@ private:
         return 800 + static_cast<uint16_t>((static_cast<uint32_t>(value & 0xFFF) * 1400 + 0x800) / 0x1000);
     }
 
-    static uint16_t CalculateCrc16(const volatile uint8_t* data, uint8_t count)
+    // The same in the fixed point of FrameSnapshot
+    static uint16_t DataToPulseWidth(uint16_t value)
     {
-        uint16_t crc = 0;
-
-        for (uint8_t i = 0; i < count; i++)
-        {
-            crc = CalculateCrc16(crc, data[i]);
-        }
-
-        return crc;
+        return static_cast<uint16_t>((((800 * 0x1000 + static_cast<uint32_t>(value & 0xFFF) * 1400) << FrameSnapshot::fractionBits) + 0x800) / 0x1000);
     }
 
-    static uint16_t CalculateCrc16(uint16_t crc, uint8_t value)
+    // CRC-16/XMODEM (polynomial 0x1021), updated one byte at a time.
+    // Branch-free and table-free, so the cost per byte is constant.
+    static uint16_t UpdateCrc16(uint16_t crc, uint8_t value)
     {
-        crc = crc ^ (static_cast<uint16_t>(value) << 8);
-
-        for (uint8_t i = 0; i < 8; i++)
-        {
-            if ((crc & 0x8000) != 0)
-            {
-                crc = (crc << 1) ^ 0x1021;
-            }
-            else
-            {
-                crc = crc << 1;
-            }
-        }
-
-        return crc;
+        uint8_t x = static_cast<uint8_t>(crc >> 8) ^ value;
+        x ^= x >> 4;
+        return (crc << 8) ^ (static_cast<uint16_t>(x) << 12) ^ (static_cast<uint16_t>(x) << 5) ^ x;
     }
 
 private:
@@ -222,12 +294,18 @@ private:
         ReceivingData,
     };
 
-    volatile uint8_t m_frame[2][1 + 16 * 2 + 2] = {};
-    volatile State m_state = State::WaitingForSync;
-    volatile uint8_t m_bytesReceived = 0;
-    volatile uint8_t m_currentBank = 0;
-    volatile uint8_t m_channelCount = 0;
-    volatile uint8_t m_timeoutCounter = 0;
-    volatile bool m_isReceiving = false;
-    volatile bool m_hasNewData = false;
+    // Not volatile, so the decoder keeps its state in registers. Other contexts go
+    // through the atomic helpers, m_frameLock, or an AutoLock.
+    uint8_t m_frame[2][1 + 16 * 2 + 2] = {};
+    uint32_t m_frameTime = 0;
+    State m_state = State::WaitingForSync;
+    uint16_t m_crc = 0;
+    uint8_t m_bytesReceived = 0;
+    uint8_t m_currentBank = 0;
+    uint8_t m_channelCount = 0;
+    uint16_t m_timeoutDeadline = 0;
+    bool m_frameReceived = false;
+    bool m_isReceiving = false;
+    bool m_hasNewData = false;
+    atl::SeqLock m_frameLock;
 };
@@ -0,0 +1,90 @@
+//
+// system_timer3.h
+// Copyright (C) 2018 Marius Greuel
+// SPDX-License-Identifier: GPL-3.0-or-later
+//
+
+#pragma once
+#include <atl/autolock.h>
+#include <avr/io.h>
+#include <shared/timer_traits.h>
+#include <stdint.h>
+
+// Free-running Timer3 at clk/8, extended to 32 bits by counting overflows.
+// It keeps the system time off Timer1, which is left to input capture and
+// the decoder timeouts, so its prescaler can be chosen for capture resolution alone.
+// There is no periodic tick: milliseconds are derived from the extended count
+// when the main loop asks for them, and timeouts are deadlines against that time.
+// The only interrupt is the overflow every 65536 ticks, about 30 per second at 16 MHz.
+class SystemTimer3 : public TimerTraits<F_CPU, 8>
+{
+    static const uint16_t millisecondUs = 1000;
+
+public:
+    void Initialize()
+    {
+        // clk/8
+        TCCR3A = 0;
+        TCCR3B = _BV(CS31);
+
+        // Clear pending IRQs
+        TIFR3 |= _BV(TOV3);
+
+        // Enable IRQs: Overflow
+        TIMSK3 |= _BV(TOIE3);
+    }
+
+    static volatile uint16_t& TCNT()
+    {
+        return TCNT3;
+    }
+
+    uint32_t GetTicks() const
+    {
+        atl::AutoLock lock;
+        return ExtendTicks(TCNT3);
+    }
+
+    // Extends a count read with interrupts disabled, e.g. in an ISR,
+    // to 32 bits. It must be read less than half a timer period ago.
+    uint32_t ExtendTicks(uint16_t ticks) const
+    {
+        uint16_t overflows = m_overflows;
+
+        // The counter has wrapped before the read, but the overflow ISR has not run yet.
+        // A pending overflow with a large count happened after the read.
+        if ((TIFR3 & _BV(TOV3)) != 0 && ticks < 0x8000)
+        {
+            overflows++;
+        }
+
+        return (static_cast<uint32_t>(overflows) << 16) | ticks;
+    }
+
+    // Advances the milliseconds by the ticks elapsed since the last call.
+    // Called from the main loop only.
+    uint16_t GetMilliseconds()
+    {
+        uint32_t elapsed = GetTicks() - m_millisecondTicks;
+        if (elapsed >= UsToTicks(millisecondUs))
+        {
+            uint16_t milliseconds = elapsed < 0x10000
+                ? static_cast<uint16_t>(elapsed) / UsToTicks(millisecondUs)
+                : static_cast<uint16_t>(elapsed / UsToTicks(millisecondUs));
+            m_milliseconds += milliseconds;
+            m_millisecondTicks += static_cast<uint32_t>(milliseconds) * UsToTicks(millisecondUs);
+        }
+
+        return m_milliseconds;
+    }
+
+    void OnOverflow()
+    {
+        m_overflows++;
+    }
+
+private:
+    volatile uint16_t m_overflows = 0;
+    uint32_t m_millisecondTicks = 0;
+    uint16_t m_milliseconds = 0;
+};
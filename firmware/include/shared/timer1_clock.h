@@ -0,0 +1,82 @@
+//
+// timer1_clock.h
+// Copyright (C) 2018 Marius Greuel
+// SPDX-License-Identifier: GPL-3.0-or-later
+//
+
+#pragma once
+#include <atl/autolock.h>
+#include <atl/memory.h>
+#include <avr/io.h>
+#include <shared/timer_traits.h>
+#include <stdint.h>
+
+// Timer1 prescaler, 8 or 1. clk/1 gives 62.5ns resolution at 16 MHz,
+// but the 16-bit counter then wraps every 4.096ms instead of every 32.768ms.
+#ifndef TIMER1_PRESCALER
+#define TIMER1_PRESCALER 8
+#endif
+
+// Tick rate of Timer1, shared by the decoder timer policies.
+class Timer1Clock : public TimerTraits<F_CPU, TIMER1_PRESCALER>
+{
+public:
+    // Where the decoders keep the tables they generate at compile time
+    using TableMemory = atl::ProgmemTraits;
+
+    static const uint8_t prescaler = TIMER1_PRESCALER;
+    static const uint8_t clockSelect = prescaler == 1 ? _BV(CS10) : _BV(CS11);
+
+    static_assert(prescaler == 1 || prescaler == 8, "Timer1 prescaler must be 1 or 8");
+
+    static void Start()
+    {
+        TCCR1A = 0;
+        TCCR1B = clockSelect;
+    }
+};
+
+// Extends Timer1 to 32 bits by counting overflows, so capture times keep
+// their resolution over spans longer than the 16-bit timer period.
+class ExtendedTimer1 : public Timer1Clock
+{
+public:
+    void Initialize()
+    {
+        // Clear pending IRQs
+        TIFR1 = _BV(TOV1);
+
+        // Enable IRQs: Overflow
+        TIMSK1 |= _BV(TOIE1);
+    }
+
+    uint32_t GetTicks() const
+    {
+        atl::AutoLock lock;
+        return ExtendTicks(TCNT1);
+    }
+
+    // Extends a count read with interrupts disabled, e.g. ICR1 in the capture ISR,
+    // to 32 bits. It must have been captured less than half a timer period ago.
+    uint32_t ExtendTicks(uint16_t ticks) const
+    {
+        uint16_t overflows = m_overflows;
+
+        // The counter has wrapped before the capture, but the overflow ISR has not run yet.
+        // A pending overflow with a large count happened after the capture.
+        if ((TIFR1 & _BV(TOV1)) != 0 && ticks < 0x8000)
+        {
+            overflows++;
+        }
+
+        return (static_cast<uint32_t>(overflows) << 16) | ticks;
+    }
+
+    void OnOverflow()
+    {
+        m_overflows++;
+    }
+
+private:
+    volatile uint16_t m_overflows = 0;
+};
@@ -0,0 +1,87 @@
+//
+// timer_traits.h
+// Copyright (C) 2018 Marius Greuel
+// SPDX-License-Identifier: GPL-3.0-or-later
+//
+
+#pragma once
+#include <stdint.h>
+
+// Conversions between ticks and microseconds for a timer running at clock / prescaler.
+// Each conversion is a 16x16-bit multiply and a shift, with constants computed at
+// compile time, so there is no division at runtime. The results are exact if the
+// tick rate is a power-of-two multiple or fraction of 1 MHz, e.g. 16 MHz or 8 MHz
+// with a prescaler of 1 or 8. Other rates are within a relative error of 1e-4.
+template<uint32_t clock, uint16_t prescaler>
+class TimerTraits
+{
+    static constexpr uint32_t Gcd(uint32_t a, uint32_t b)
+    {
+        return b == 0 ? a : Gcd(b, a % b);
+    }
+
+    // ceil(2^shift * numerator / denominator)
+    static constexpr uint32_t GetMultiplier(uint32_t numerator, uint32_t denominator, uint8_t shift)
+    {
+        return static_cast<uint32_t>(((static_cast<uint64_t>(numerator) << shift) + denominator - 1) / denominator);
+    }
+
+    // Largest shift with a 16-bit multiplier
+    static constexpr uint8_t GetMaxShift(uint32_t numerator, uint32_t denominator, uint8_t shift = 31)
+    {
+        return shift == 0 || GetMultiplier(numerator, denominator, shift) <= 0xFFFF ? shift : GetMaxShift(numerator, denominator, shift - 1);
+    }
+
+    // Drops trailing zero bits of the multiplier, so 2^n ratios become plain shifts
+    static constexpr uint8_t ReduceShift(uint32_t multiplier, uint8_t shift)
+    {
+        return shift > 0 && (multiplier & 1) == 0 ? ReduceShift(multiplier >> 1, shift - 1) : shift;
+    }
+
+    static constexpr uint8_t GetShift(uint32_t numerator, uint32_t denominator)
+    {
+        return ReduceShift(GetMultiplier(numerator, denominator, GetMaxShift(numerator, denominator)), GetMaxShift(numerator, denominator));
+    }
+
+    static const uint32_t tickRate = clock / prescaler;
+    static const uint32_t usPerTickNumerator = 1000000 / Gcd(1000000, tickRate);
+    static const uint32_t ticksPerUsNumerator = tickRate / Gcd(1000000, tickRate);
+
+    static const uint8_t ticksToUsShift = GetShift(usPerTickNumerator, ticksPerUsNumerator);
+    static const uint16_t ticksToUsMultiplier = GetMultiplier(usPerTickNumerator, ticksPerUsNumerator, ticksToUsShift);
+    static const uint8_t usToTicksShift = GetShift(ticksPerUsNumerator, usPerTickNumerator);
+    static const uint16_t usToTicksMultiplier = GetMultiplier(ticksPerUsNumerator, usPerTickNumerator, usToTicksShift);
+
+    static_assert(GetMultiplier(usPerTickNumerator, ticksPerUsNumerator, ticksToUsShift) <= 0xFFFF, "Tick rate too low");
+    static_assert(GetMultiplier(ticksPerUsNumerator, usPerTickNumerator, usToTicksShift) <= 0xFFFF, "Tick rate too high");
+
+public:
+    static constexpr uint16_t TicksToUs(uint16_t ticks)
+    {
+        return static_cast<uint16_t>((static_cast<uint32_t>(ticks) * ticksToUsMultiplier) >> ticksToUsShift);
+    }
+
+    // Truncated to 16 bits, use UsToTicks32() where the result may not fit.
+    static constexpr uint16_t UsToTicks(uint16_t us)
+    {
+        return static_cast<uint16_t>(UsToTicks32(us));
+    }
+
+    static constexpr uint32_t UsToTicks32(uint16_t us)
+    {
+        return (static_cast<uint32_t>(us) * usToTicksMultiplier) >> usToTicksShift;
+    }
+
+    // For spans of a 32-bit extended count, converted in two 16-bit halves
+    static constexpr uint32_t TicksToUs32(uint32_t ticks)
+    {
+        return ShiftLeft(static_cast<uint32_t>(static_cast<uint16_t>(ticks >> 16)) * ticksToUsMultiplier, 16 - ticksToUsShift) +
+            ((static_cast<uint32_t>(static_cast<uint16_t>(ticks)) * ticksToUsMultiplier) >> ticksToUsShift);
+    }
+
+private:
+    static constexpr uint32_t ShiftLeft(uint32_t value, int8_t shift)
+    {
+        return shift >= 0 ? value << shift : value >> -shift;
+    }
+};
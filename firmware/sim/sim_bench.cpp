@@ -0,0 +1,589 @@
+//
+// sim_bench.cpp
+// Copyright (C) 2018 Marius Greuel
+// SPDX-License-Identifier: GPL-3.0-or-later
+//
+
+// Firmware-in-the-loop benchmark: runs the firmware built with HIDRCJOY_SIM=1
+// in simavr, feeds it synthetic PPM and PCM waveforms on ICP1 (and PB3 for the
+// PCINT input) and SRXL frames on USART1, and reports the cycles spent in each
+// ISR, the main loop iterations per frame, and the decoded channel values.
+//
+// Usage: sim_bench firmware.elf [frequency]
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include <avr_ioport.h>
+#include <avr_timer.h>
+#include <avr_uart.h>
+#include <sim_avr.h>
+#include <sim_elf.h>
+#include <sim_interrupts.h>
+#include <sim_irq.h>
+
+/////////////////////////////////////////////////////////////////////////////
+
+// ATmega32U4 data space addresses, see sim_probe.h for the markers
+static const avr_io_addr_t GPIOR0 = 0x3E;
+static const avr_io_addr_t GPIOR1 = 0x4A;
+static const avr_io_addr_t PLLCSR = 0x49;
+static const uint8_t PLOCK = 0;
+
+enum Marker : uint8_t
+{
+    MainLoop = 1,
+    Frame = 2,
+};
+
+struct Vector
+{
+    uint8_t m_number;
+    const char* m_name;
+};
+
+static const Vector vectors[] =
+{
+    { 9, "PCINT0" },
+    { 10, "USB_GEN" },
+    { 11, "USB_COM" },
+    { 16, "TIMER1_CAPT" },
+    { 18, "TIMER1_COMPB" },
+    { 19, "TIMER1_COMPC" },
+    { 20, "TIMER1_OVF" },
+    { 25, "USART1_RX" },
+    { 35, "TIMER3_OVF" },
+};
+
+static const char* const signalSourceNames[] = { "None", "PPM", "PCM", "SRXL" };
+
+static const uint8_t vectorCount = sizeof(vectors) / sizeof(vectors[0]);
+static const uint8_t maxChannelCount = 16;
+
+/////////////////////////////////////////////////////////////////////////////
+
+// Input events in simulated time.
+struct Event
+{
+    enum Type : uint8_t
+    {
+        Level,
+        Data,
+    };
+
+    double m_time;
+    Type m_type;
+    uint8_t m_value;
+};
+
+// A synthetic signal with the pulse widths the firmware is expected to decode.
+struct Waveform
+{
+    void AddLevel(double time, bool level)
+    {
+        m_events.push_back(Event{ time, Event::Level, level });
+    }
+
+    void AddData(double time, uint8_t data)
+    {
+        m_events.push_back(Event{ time, Event::Data, data });
+    }
+
+    std::vector<Event> m_events;
+    uint16_t m_expected[maxChannelCount] = {};
+    uint8_t m_expectedCount = 0;
+    uint32_t m_frames = 0;
+    double m_duration = 0;
+};
+
+// PPM with 8 channels at 1000..1700us, positive 300us pulses, 22.5ms frames.
+static Waveform CreatePpm(uint32_t frames)
+{
+    static const uint8_t channelCount = 8;
+    static const double pulseWidth = 300;
+    static const double framePeriod = 22500;
+
+    Waveform waveform;
+    waveform.AddLevel(0, false);
+    double time = 1000;
+    for (uint32_t frame = 0; frame < frames; frame++)
+    {
+        double start = time;
+        for (uint8_t i = 0; i <= channelCount; i++)
+        {
+            waveform.AddLevel(time, true);
+            waveform.AddLevel(time + pulseWidth, false);
+            if (i < channelCount)
+            {
+                time += 1000 + 100 * i;
+            }
+        }
+
+        time = start + framePeriod;
+    }
+
+    for (uint8_t i = 0; i < channelCount; i++)
+    {
+        waveform.m_expected[i] = 1000 + 100 * i;
+    }
+
+    waveform.m_expectedCount = channelCount;
+    waveform.m_frames = frames;
+    waveform.m_duration = time;
+    return waveform;
+}
+
+// Multiplex PCM: a sync pause, then 8 channels of four bit pairs and a checksum pair,
+// and two more pairs that select channels 6 and 7. Each bit pair is sent as the time
+// between falling edges, 880us + 140us * (bits + 3 - previous bits).
+class PcmEncoder
+{
+public:
+    PcmEncoder(Waveform& waveform, double time) : m_waveform(waveform), m_time(time)
+    {
+    }
+
+    void AddSync()
+    {
+        m_waveform.AddLevel(m_time, false);
+        m_time += 2800;
+        m_waveform.AddLevel(m_time, true);
+        m_time += 50;
+        m_waveform.AddLevel(m_time, false);
+        m_lastBits = 3;
+    }
+
+    void AddChannel(uint8_t value)
+    {
+        uint8_t checksum = 3;
+        for (int8_t i = 3; i >= 0; i--)
+        {
+            uint8_t bits = (value >> (2 * i)) & 3;
+            checksum ^= bits;
+            AddBits(bits);
+        }
+
+        AddBits(checksum);
+    }
+
+    void AddBits(uint8_t bits)
+    {
+        double period = 880 + 140 * (bits + 3 - m_lastBits);
+        m_lastBits = bits;
+        m_waveform.AddLevel(m_time + period / 4, true);
+        m_time += period;
+        m_waveform.AddLevel(m_time, false);
+    }
+
+    double GetTime() const
+    {
+        return m_time;
+    }
+
+private:
+    Waveform& m_waveform;
+    double m_time;
+    uint8_t m_lastBits = 3;
+};
+
+static Waveform CreatePcm(uint32_t frames)
+{
+    static const uint8_t channelCount = 8;
+
+    Waveform waveform;
+    waveform.AddLevel(0, false);
+    double time = 1000;
+    for (uint32_t frame = 0; frame < frames; frame++)
+    {
+        PcmEncoder encoder(waveform, time);
+        encoder.AddSync();
+        for (uint8_t i = 0; i < channelCount; i++)
+        {
+            // The firmware reports the inverted value
+            encoder.AddChannel(static_cast<uint8_t>(~(32 * i)));
+        }
+
+        encoder.AddBits(0xC >> 2);
+        encoder.AddBits(0xC & 3);
+        time = encoder.GetTime();
+    }
+
+    for (uint8_t i = 0; i < channelCount; i++)
+    {
+        waveform.m_expected[i] = 1050 + 138 * (32 * i) / 0x20;
+    }
+
+    waveform.m_expectedCount = channelCount;
+    waveform.m_frames = frames;
+    waveform.m_duration = time;
+    return waveform;
+}
+
+static uint16_t UpdateCrc16(uint16_t crc, uint8_t value)
+{
+    crc ^= static_cast<uint16_t>(value) << 8;
+    for (uint8_t i = 0; i < 8; i++)
+    {
+        crc = (crc & 0x8000) != 0 ? (crc << 1) ^ 0x1021 : crc << 1;
+    }
+
+    return crc;
+}
+
+// Multiplex SRXL V1: header, 12 big-endian 12-bit channels, CRC-16/XMODEM, every 14ms.
+static Waveform CreateSrxl(uint32_t frames)
+{
+    static const uint8_t channelCount = 12;
+    static const double framePeriod = 14000;
+    static const double byteTime = 10 * 1000000.0 / 115200;
+
+    uint8_t frame[1 + channelCount * 2 + 2];
+    frame[0] = 0xA1;
+    for (uint8_t i = 0; i < channelCount; i++)
+    {
+        uint16_t value = 0x155 * i;
+        frame[1 + i * 2] = static_cast<uint8_t>(value >> 8);
+        frame[2 + i * 2] = static_cast<uint8_t>(value);
+    }
+
+    uint16_t crc = 0;
+    for (uint8_t i = 0; i < sizeof(frame) - 2; i++)
+    {
+        crc = UpdateCrc16(crc, frame[i]);
+    }
+
+    frame[sizeof(frame) - 2] = static_cast<uint8_t>(crc >> 8);
+    frame[sizeof(frame) - 1] = static_cast<uint8_t>(crc);
+
+    Waveform waveform;
+    double time = 10000;
+    for (uint32_t i = 0; i < frames; i++)
+    {
+        for (uint8_t j = 0; j < sizeof(frame); j++)
+        {
+            waveform.AddData(time + j * byteTime, frame[j]);
+        }
+
+        time += framePeriod;
+    }
+
+    for (uint8_t i = 0; i < channelCount; i++)
+    {
+        waveform.m_expected[i] = 800 + static_cast<uint16_t>((static_cast<uint32_t>(0x155 * i) * 1400 + 0x800) / 0x1000);
+    }
+
+    waveform.m_expectedCount = channelCount;
+    waveform.m_frames = frames;
+    waveform.m_duration = time;
+    return waveform;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+class Bench
+{
+    struct IsrStatistics
+    {
+        uint32_t m_count;
+        uint64_t m_totalCycles;
+        uint32_t m_minCycles;
+        uint32_t m_maxCycles;
+        avr_cycle_count_t m_startCycle;
+    };
+
+    struct VectorContext
+    {
+        Bench* m_bench;
+        uint8_t m_index;
+    };
+
+public:
+    bool Initialize(const char* filename, uint32_t frequency)
+    {
+        elf_firmware_t firmware;
+        memset(&firmware, 0, sizeof(firmware));
+        if (elf_read_firmware(filename, &firmware) != 0)
+        {
+            fprintf(stderr, "Failed to read '%s'\n", filename);
+            return false;
+        }
+
+        m_avr = avr_make_mcu_by_name("atmega32u4");
+        if (m_avr == nullptr)
+        {
+            fprintf(stderr, "simavr does not support the atmega32u4\n");
+            return false;
+        }
+
+        avr_init(m_avr);
+        avr_load_firmware(m_avr, &firmware);
+        m_avr->frequency = frequency;
+
+        // There is no USB host, but the firmware waits for the USB PLL to lock
+        avr_register_io_read(m_avr, PLLCSR, &Bench::OnReadPllcsr, this);
+        avr_register_io_write(m_avr, GPIOR0, &Bench::OnWriteMarker, this);
+        avr_register_io_write(m_avr, GPIOR1, &Bench::OnWriteFrameData, this);
+
+        for (uint8_t i = 0; i < vectorCount; i++)
+        {
+            m_vectorContexts[i] = VectorContext{ this, i };
+            avr_irq_t* irq = avr_get_interrupt_irq(m_avr, vectors[i].m_number);
+            if (irq != nullptr)
+            {
+                avr_irq_register_notify(irq + AVR_INT_IRQ_RUNNING, &Bench::OnInterruptRunning, &m_vectorContexts[i]);
+            }
+        }
+
+        m_icpIrq = avr_io_getirq(m_avr, AVR_IOCTL_TIMER_GETIRQ('1'), TIMER_IRQ_IN_ICP);
+        m_icpPinIrq = avr_io_getirq(m_avr, AVR_IOCTL_IOPORT_GETIRQ('D'), 4);
+        m_pcintPinIrq = avr_io_getirq(m_avr, AVR_IOCTL_IOPORT_GETIRQ('B'), 3);
+        m_uartIrq = avr_io_getirq(m_avr, AVR_IOCTL_UART_GETIRQ('1'), UART_IRQ_INPUT);
+        if (m_icpIrq == nullptr || m_uartIrq == nullptr)
+        {
+            fprintf(stderr, "simavr lacks the timer input capture or USART IRQs\n");
+            return false;
+        }
+
+        // Let the firmware start up and enumerate nothing
+        return Run(500000);
+    }
+
+    bool RunScenario(const char* name, const Waveform& waveform)
+    {
+        ResetStatistics();
+        m_waveform = &waveform;
+        m_nextEvent = 0;
+        m_startCycle = m_avr->cycle;
+
+        if (!m_waveform->m_events.empty())
+        {
+            avr_cycle_timer_register(m_avr, ToCycles(m_waveform->m_events[0].m_time) - m_avr->cycle, &Bench::OnEvent, this);
+        }
+
+        bool result = Run(waveform.m_duration);
+        avr_cycle_timer_cancel(m_avr, &Bench::OnEvent, this);
+        m_waveform = nullptr;
+        PrintResults(name, waveform);
+
+        // Let the decoders time out and the receiver release its lock-in
+        return result && Run(3000000);
+    }
+
+private:
+    bool Run(double us)
+    {
+        avr_cycle_count_t endCycle = m_avr->cycle + avr_usec_to_cycles(m_avr, static_cast<uint32_t>(us));
+        while (m_avr->cycle < endCycle)
+        {
+            int state = avr_run(m_avr);
+            if (state == cpu_Done || state == cpu_Crashed)
+            {
+                fprintf(stderr, "Firmware stopped at cycle %llu\n", static_cast<unsigned long long>(m_avr->cycle));
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    avr_cycle_count_t ToCycles(double us) const
+    {
+        return m_startCycle + static_cast<avr_cycle_count_t>(us * m_avr->frequency / 1000000);
+    }
+
+    void ResetStatistics()
+    {
+        memset(m_isrStatistics, 0, sizeof(m_isrStatistics));
+        m_mainLoops = 0;
+        m_frames = 0;
+        m_frameSource = 0;
+        m_frameChannelCount = 0;
+        memset(m_frameChannels, 0, sizeof(m_frameChannels));
+    }
+
+    void PrintResults(const char* name, const Waveform& waveform) const
+    {
+        double cycles = static_cast<double>(m_avr->cycle - m_startCycle);
+        uint32_t frames = m_frames > 0 ? m_frames : 1;
+
+        printf("== %s: %u frames sent, %u decoded", name, waveform.m_frames, m_frames);
+        printf(", last from %s\n", m_frameSource < 4 ? signalSourceNames[m_frameSource] : "?");
+
+        printf("%-14s %8s %8s %8s %8s %12s\n", "ISR", "count", "min", "avg", "max", "cycles/frame");
+        for (uint8_t i = 0; i < vectorCount; i++)
+        {
+            const IsrStatistics& statistics = m_isrStatistics[i];
+            if (statistics.m_count > 0)
+            {
+                printf("%-14s %8u %8u %8.1f %8u %12.1f\n",
+                    vectors[i].m_name,
+                    statistics.m_count,
+                    statistics.m_minCycles,
+                    static_cast<double>(statistics.m_totalCycles) / statistics.m_count,
+                    statistics.m_maxCycles,
+                    static_cast<double>(statistics.m_totalCycles) / frames);
+            }
+        }
+
+        printf("main loop: %.1f iterations/frame, %.1f cycles/iteration\n",
+            static_cast<double>(m_mainLoops) / frames,
+            m_mainLoops > 0 ? cycles / m_mainLoops : 0.0);
+
+        printf("%-8s", "decoded");
+        for (uint8_t i = 0; i < m_frameChannelCount; i++)
+        {
+            printf(" %5u", m_frameChannels[i]);
+        }
+
+        printf("\n%-8s", "expected");
+        for (uint8_t i = 0; i < waveform.m_expectedCount; i++)
+        {
+            printf(" %5u", waveform.m_expected[i]);
+        }
+
+        printf("\n\n");
+    }
+
+    static avr_cycle_count_t OnEvent(avr_t* avr, avr_cycle_count_t, void* param)
+    {
+        Bench* bench = static_cast<Bench*>(param);
+        const std::vector<Event>& events = bench->m_waveform->m_events;
+
+        while (bench->m_nextEvent < events.size() && bench->ToCycles(events[bench->m_nextEvent].m_time) <= avr->cycle)
+        {
+            const Event& event = events[bench->m_nextEvent++];
+            if (event.m_type == Event::Level)
+            {
+                avr_raise_irq(bench->m_icpPinIrq, event.m_value);
+                avr_raise_irq(bench->m_pcintPinIrq, event.m_value);
+                avr_raise_irq(bench->m_icpIrq, event.m_value);
+            }
+            else
+            {
+                avr_raise_irq(bench->m_uartIrq, event.m_value);
+            }
+        }
+
+        return bench->m_nextEvent < events.size() ? bench->ToCycles(events[bench->m_nextEvent].m_time) : 0;
+    }
+
+    static void OnInterruptRunning(avr_irq_t*, uint32_t value, void* param)
+    {
+        const VectorContext* context = static_cast<const VectorContext*>(param);
+        Bench* bench = context->m_bench;
+        IsrStatistics& statistics = bench->m_isrStatistics[context->m_index];
+        if (value != 0)
+        {
+            statistics.m_startCycle = bench->m_avr->cycle;
+        }
+        else
+        {
+            uint32_t cycles = static_cast<uint32_t>(bench->m_avr->cycle - statistics.m_startCycle);
+            if (statistics.m_count == 0 || cycles < statistics.m_minCycles)
+            {
+                statistics.m_minCycles = cycles;
+            }
+
+            if (cycles > statistics.m_maxCycles)
+            {
+                statistics.m_maxCycles = cycles;
+            }
+
+            statistics.m_count++;
+            statistics.m_totalCycles += cycles;
+        }
+    }
+
+    static uint8_t OnReadPllcsr(avr_t* avr, avr_io_addr_t addr, void*)
+    {
+        return avr->data[addr] | (1 << PLOCK);
+    }
+
+    static void OnWriteMarker(avr_t* avr, avr_io_addr_t addr, uint8_t value, void* param)
+    {
+        Bench* bench = static_cast<Bench*>(param);
+        avr->data[addr] = value;
+
+        if (value == Marker::MainLoop)
+        {
+            bench->m_mainLoops++;
+        }
+        else if (value == Marker::Frame)
+        {
+            bench->m_frameBytes = 0;
+        }
+    }
+
+    // Signal source, channel count, then the pulse widths, low byte first
+    static void OnWriteFrameData(avr_t* avr, avr_io_addr_t addr, uint8_t value, void* param)
+    {
+        Bench* bench = static_cast<Bench*>(param);
+        avr->data[addr] = value;
+
+        uint16_t index = bench->m_frameBytes++;
+        if (index == 0)
+        {
+            bench->m_frameSource = value;
+        }
+        else if (index == 1)
+        {
+            bench->m_frameChannelCount = value <= maxChannelCount ? value : maxChannelCount;
+            bench->m_frames++;
+        }
+        else if (index - 2 < bench->m_frameChannelCount * 2)
+        {
+            uint8_t channel = (index - 2) / 2;
+            if ((index & 1) == 0)
+            {
+                bench->m_frameChannels[channel] = value;
+            }
+            else
+            {
+                bench->m_frameChannels[channel] |= static_cast<uint16_t>(value) << 8;
+            }
+        }
+    }
+
+private:
+    avr_t* m_avr = nullptr;
+    avr_irq_t* m_icpIrq = nullptr;
+    avr_irq_t* m_icpPinIrq = nullptr;
+    avr_irq_t* m_pcintPinIrq = nullptr;
+    avr_irq_t* m_uartIrq = nullptr;
+    VectorContext m_vectorContexts[vectorCount] = {};
+    IsrStatistics m_isrStatistics[vectorCount] = {};
+    const Waveform* m_waveform = nullptr;
+    size_t m_nextEvent = 0;
+    avr_cycle_count_t m_startCycle = 0;
+    uint32_t m_mainLoops = 0;
+    uint32_t m_frames = 0;
+    uint16_t m_frameBytes = 0;
+    uint8_t m_frameSource = 0;
+    uint8_t m_frameChannelCount = 0;
+    uint16_t m_frameChannels[maxChannelCount] = {};
+};
+
+int main(int argc, char* argv[])
+{
+    if (argc < 2)
+    {
+        fprintf(stderr, "Usage: %s firmware.elf [frequency]\n", argv[0]);
+        return 2;
+    }
+
+    uint32_t frequency = argc > 2 ? strtoul(argv[2], nullptr, 0) : 16000000;
+
+    static Bench bench;
+    if (!bench.Initialize(argv[1], frequency))
+        return 1;
+
+    if (!bench.RunScenario("PPM", CreatePpm(100)) ||
+        !bench.RunScenario("PCM", CreatePcm(40)) ||
+        !bench.RunScenario("SRXL", CreateSrxl(150)))
+        return 1;
+
+    return 0;
+}
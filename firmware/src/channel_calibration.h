@@ -0,0 +1,147 @@
+//
+// channel_calibration.h
+// Copyright (C) 2018 Marius Greuel
+// SPDX-License-Identifier: GPL-3.0-or-later
+//
+
+#pragma once
+#include <stdint.h>
+
+// Maps a channel pulse width to a signed joystick value.
+// The halves below and above the center are scaled separately, so transmitters
+// with asymmetric endpoints reach the full range on both sides.
+// Initialize() does the divisions once per configuration change,
+// Apply() only needs a multiply, shifts and compares.
+class ChannelCalibration
+{
+    struct Half
+    {
+        int32_t m_scale;
+        int16_t m_limit;
+    };
+
+public:
+    static const int16_t maxValue = 32767;
+
+    // lowRange and highRange are the widths from the center to the min and max endpoints.
+    void Initialize(uint16_t center, uint16_t lowRange, uint16_t highRange, uint8_t deadband, uint8_t expo, bool inverted)
+    {
+        // Inverting negates the offset first, so the halves swap
+        InitializeHalf(m_low, inverted ? highRange : lowRange, deadband);
+        InitializeHalf(m_high, inverted ? lowRange : highRange, deadband);
+        m_center = center;
+        m_deadband = deadband;
+        m_expo = static_cast<uint16_t>(expo) * 256 / 100;
+        m_inverted = inverted;
+    }
+
+    // Returns a value in the range -maxValue..maxValue.
+    int16_t Apply(uint16_t pulseWidth) const
+    {
+        int16_t value = static_cast<int16_t>(pulseWidth - m_center);
+        if (m_inverted)
+        {
+            value = -value;
+        }
+
+        if (value > m_deadband)
+        {
+            value -= m_deadband;
+            if (value > m_high.m_limit)
+            {
+                value = m_high.m_limit;
+            }
+
+            value = static_cast<int16_t>((static_cast<int32_t>(value) * m_high.m_scale) >> 16);
+        }
+        else if (value < -m_deadband)
+        {
+            value += m_deadband;
+            if (value < -m_low.m_limit)
+            {
+                value = -m_low.m_limit;
+            }
+
+            value = static_cast<int16_t>((static_cast<int32_t>(value) * m_low.m_scale) >> 16);
+        }
+        else
+        {
+            value = 0;
+        }
+
+        if (m_expo != 0)
+        {
+            value = ApplyExpo(value);
+        }
+
+        return value;
+    }
+
+    // Apply() for a pulse width with fractionBits below the microsecond.
+    // The scaling is done in 32 bits, so the fraction is not lost before it.
+    template<uint8_t fractionBits>
+    int16_t ApplyFixedPoint(uint16_t pulseWidth) const
+    {
+        int32_t value = static_cast<int32_t>(pulseWidth) - (static_cast<int32_t>(m_center) << fractionBits);
+        if (m_inverted)
+        {
+            value = -value;
+        }
+
+        int32_t deadband = static_cast<int32_t>(m_deadband) << fractionBits;
+        if (value > deadband)
+        {
+            value = Scale(value - deadband, m_high, fractionBits);
+        }
+        else if (value < -deadband)
+        {
+            value = -Scale(-value - deadband, m_low, fractionBits);
+        }
+        else
+        {
+            value = 0;
+        }
+
+        if (m_expo != 0)
+        {
+            return ApplyExpo(static_cast<int16_t>(value));
+        }
+
+        return static_cast<int16_t>(value);
+    }
+
+private:
+    // The scale is reduced by the fraction first, so the product fits 32 bits
+    static int32_t Scale(int32_t value, const Half& half, uint8_t fractionBits)
+    {
+        int32_t limit = static_cast<int32_t>(half.m_limit) << fractionBits;
+        if (value > limit)
+        {
+            value = limit;
+        }
+
+        return (value * (half.m_scale >> fractionBits)) >> 16;
+    }
+
+    static void InitializeHalf(Half& half, uint16_t range, uint8_t deadband)
+    {
+        half.m_limit = range > deadband ? range - deadband : 1;
+        half.m_scale = (static_cast<int32_t>(maxValue) << 16) / half.m_limit;
+    }
+
+    // Blends the linear value with its cube: y = x + expo * (x^3 - x)
+    int16_t ApplyExpo(int16_t value) const
+    {
+        int16_t square = static_cast<int16_t>((static_cast<int32_t>(value) * value) >> 15);
+        int16_t cube = static_cast<int16_t>((static_cast<int32_t>(square) * value) >> 15);
+        return value + static_cast<int16_t>(((static_cast<int32_t>(cube) - value) * m_expo) >> 8);
+    }
+
+private:
+    Half m_low = { 0, 1 };
+    Half m_high = { 0, 1 };
+    uint16_t m_center = 0;
+    uint16_t m_expo = 0;
+    uint8_t m_deadband = 0;
+    bool m_inverted = false;
+};
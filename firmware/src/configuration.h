@@ -12,17 +12,30 @@
 struct Configuration
 {
 #ifdef __cplusplus
-    static const uint8_t version = 0x11;
+    static const uint8_t version = 0x16;
     static const uint8_t maxInputChannels = 7;
     static const uint8_t maxOutputChannels = 7;
     static const uint16_t minSyncWidth = 2000;
     static const uint16_t maxSyncWidth = 10000;
     static const uint16_t minChannelPulseWidth = 500;
     static const uint16_t maxChannelPulseWidth = 3000;
+    static const uint8_t maxDeadband = 100;
+    static const uint8_t maxExpo = 100;
+    static const uint16_t maxReportPhase = 900;
+    static const uint16_t maxLockTimeout = 10000;
 
     enum Flags
     {
         InvertedSignal = 1,
+        StartOfFrameAlignedReport = 2, // Needs the 1ms polling interval of HIDRCJOY_FULL_SPEED_REPORT, ignored otherwise
+    };
+
+    enum DecoderMask
+    {
+        EnablePpm = 1,
+        EnablePcm = 2,
+        EnableSrxl = 4,
+        EnableAllDecoders = EnablePpm | EnablePcm | EnableSrxl,
     };
 #endif
 
@@ -35,4 +48,13 @@ struct Configuration
     uint16_t m_channelPulseWidthRange;
     uint8_t m_polarity;
     uint8_t m_mapping[MAX_CHANNELS];
+    uint8_t m_deadband;
+    uint8_t m_expo;
+    uint16_t m_reportPhase;
+    uint8_t m_decoderMask;
+    uint8_t m_lockFrames;
+    uint16_t m_lockTimeout;
+    // Endpoints per output channel, 0 for center -/+ range
+    uint16_t m_minChannelPulseWidth[MAX_CHANNELS];
+    uint16_t m_maxChannelPulseWidth[MAX_CHANNELS];
 };
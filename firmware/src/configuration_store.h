@@ -0,0 +1,133 @@
+//
+// configuration_store.h
+// Copyright (C) 2018 Marius Greuel
+// SPDX-License-Identifier: GPL-3.0-or-later
+//
+
+#pragma once
+#include <atl/autolock.h>
+#include <avr/eeprom.h>
+#include <util/crc16.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "configuration.h"
+
+struct ConfigurationSlot
+{
+    uint8_t m_sequence;
+    Configuration m_configuration;
+    uint16_t m_crc;
+};
+
+// Keeps the configuration in a ring of EEPROM slots. Each save goes to the
+// slot after the newest one, so an interrupted save leaves the previous copy
+// intact, and the writes are spread over all slots.
+// Save() only queues the data. RunTask() then programs at most one changed
+// byte per call and only while the EEPROM is idle, so it never blocks.
+// Only Initialize() and RunTask() access the EEPROM, both from the main loop.
+// Save() runs with interrupts enabled, Load() may be called from an interrupt.
+class ConfigurationStore
+{
+public:
+    static const uint8_t slotCount = 8;
+
+    explicit ConfigurationStore(ConfigurationSlot* slots) : m_slots(slots)
+    {
+    }
+
+    // Reads all slots and keeps a copy of the valid one with the newest sequence number.
+    void Initialize()
+    {
+        for (uint8_t i = 0; i < slotCount; i++)
+        {
+            ConfigurationSlot slot;
+            eeprom_read_block(&slot, &m_slots[i], sizeof(slot));
+            if (slot.m_crc == CalculateCrc(slot))
+            {
+                if (!m_isValid || static_cast<int8_t>(slot.m_sequence - m_slot.m_sequence) > 0)
+                {
+                    m_slot = slot;
+                    m_currentSlot = i;
+                    m_isValid = true;
+                }
+            }
+        }
+    }
+
+    // Returns the configuration most recently saved, without touching the EEPROM.
+    bool Load(Configuration& configuration) const
+    {
+        if (!m_isValid)
+            return false;
+
+        configuration = m_slot.m_configuration;
+        return true;
+    }
+
+    void Save(const Configuration& configuration)
+    {
+        // A save that is still in progress is restarted in the same slot
+        if (!m_isBusy)
+        {
+            m_currentSlot = m_currentSlot + 1 < slotCount ? m_currentSlot + 1 : 0;
+            m_slot.m_sequence++;
+        }
+
+        {
+            // Load() reads only the configuration, the CRC is computed outside the lock
+            atl::AutoLock lock;
+            m_slot.m_configuration = configuration;
+            m_isValid = true;
+        }
+
+        m_slot.m_crc = CalculateCrc(m_slot);
+        m_index = 0;
+        m_isBusy = true;
+    }
+
+    bool IsBusy() const
+    {
+        return m_isBusy;
+    }
+
+    void RunTask()
+    {
+        if (!m_isBusy || !eeprom_is_ready())
+            return;
+
+        auto source = reinterpret_cast<const uint8_t*>(&m_slot);
+        auto destination = reinterpret_cast<uint8_t*>(&m_slots[m_currentSlot]);
+        while (m_index < sizeof(m_slot))
+        {
+            uint8_t index = m_index++;
+            if (eeprom_read_byte(destination + index) != source[index])
+            {
+                eeprom_write_byte(destination + index, source[index]);
+                return;
+            }
+        }
+
+        m_isBusy = false;
+    }
+
+private:
+    static uint16_t CalculateCrc(const ConfigurationSlot& slot)
+    {
+        auto data = reinterpret_cast<const uint8_t*>(&slot);
+        uint16_t crc = 0xFFFF;
+        for (uint8_t i = 0; i < offsetof(ConfigurationSlot, m_crc); i++)
+        {
+            crc = _crc_xmodem_update(crc, data[i]);
+        }
+
+        return crc;
+    }
+
+private:
+    ConfigurationSlot* m_slots;
+    ConfigurationSlot m_slot = {};
+    uint8_t m_currentSlot = slotCount - 1;
+    uint8_t m_index = 0;
+    bool m_isValid = false;
+    bool m_isBusy = false;
+};
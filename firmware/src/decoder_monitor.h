@@ -0,0 +1,130 @@
+//
+// decoder_monitor.h
+// Copyright (C) 2018 Marius Greuel
+// SPDX-License-Identifier: GPL-3.0-or-later
+//
+
+#pragma once
+#include <atl/atomic.h>
+#include <atl/autolock.h>
+#include <shared/decoder_error.h>
+#include <stdint.h>
+#include "usb_reports.h"
+
+// Fed from a decoder's hooks, in interrupt context or, with deferred decoding,
+// from the main loop. Measures the frame period and counts frames,
+// errors and timeouts for the health report.
+// Frame times are the capture times the decoder took from the input, in 32-bit
+// extended ticks of the capture timer, so the frame period and its jitter do not
+// depend on when the hook runs, and are not affected by the 16-bit timer wrap.
+template<class timer>
+class DecoderMonitorT
+{
+public:
+    // Good frames since the last error or timeout, saturates at 255.
+    uint8_t GetConsecutiveFrames() const
+    {
+        return atl::AtomicLoad(m_consecutiveFrames);
+    }
+
+    void GetStatistics(DecoderStatistics& statistics) const
+    {
+        atl::AutoLock lock;
+        statistics = m_statistics;
+    }
+
+    void ResetStatistics()
+    {
+        atl::AutoLock lock;
+        m_statistics = DecoderStatistics();
+    }
+
+    void OnFrameReceived(uint32_t time, uint8_t channelCount)
+    {
+        // Deferred decoding runs the hooks in the main loop
+        atl::AutoLock lock;
+
+        if (m_channelCount != 0)
+        {
+            UpdateFramePeriod(timer::TicksToUs32(time - m_lastFrameTime));
+        }
+
+        m_lastFrameTime = time;
+        m_statistics.m_frames++;
+
+        if (m_consecutiveFrames < 0xFF)
+        {
+            m_consecutiveFrames++;
+        }
+
+        if (channelCount != m_channelCount)
+        {
+            if (m_channelCount != 0)
+            {
+                m_statistics.m_channelCountChanges++;
+            }
+
+            m_channelCount = channelCount;
+        }
+    }
+
+    void OnError(DecoderError error)
+    {
+        atl::AutoLock lock;
+        m_consecutiveFrames = 0;
+
+        switch (error)
+        {
+        case DecoderError::Checksum:
+            m_statistics.m_checksumErrors++;
+            break;
+        case DecoderError::ShortFrame:
+            m_statistics.m_shortFrames++;
+            break;
+        case DecoderError::LongFrame:
+            m_statistics.m_longFrames++;
+            break;
+        }
+    }
+
+    void OnTimeout()
+    {
+        atl::AutoLock lock;
+        m_statistics.m_timeouts++;
+        m_channelCount = 0;
+        m_consecutiveFrames = 0;
+    }
+
+    void OnEventsLost(uint8_t count)
+    {
+        atl::AutoLock lock;
+        m_consecutiveFrames = 0;
+        m_statistics.m_lostEvents += count;
+    }
+
+private:
+    // Jitter as in RFC 3550: J += (|D| - J) / 16, kept scaled by 16.
+    void UpdateFramePeriod(uint32_t period)
+    {
+        uint16_t framePeriod = period <= 0xFFFF ? static_cast<uint16_t>(period) : 0xFFFF;
+        uint16_t lastFramePeriod = m_statistics.m_framePeriod;
+        uint16_t difference = framePeriod > lastFramePeriod ? framePeriod - lastFramePeriod : lastFramePeriod - framePeriod;
+        if (difference > maxJitter)
+        {
+            difference = maxJitter;
+        }
+
+        m_scaledJitter += difference - (m_scaledJitter >> 4);
+        m_statistics.m_framePeriod = framePeriod;
+        m_statistics.m_frameJitter = m_scaledJitter >> 4;
+    }
+
+private:
+    static const uint16_t maxJitter = 0xFFF;
+
+    DecoderStatistics m_statistics = {};
+    uint32_t m_lastFrameTime = 0;
+    uint16_t m_scaledJitter = 0;
+    uint8_t m_channelCount = 0;
+    uint8_t m_consecutiveFrames = 0;
+};
@@ -0,0 +1,119 @@
+//
+// edge_capture.h
+// Copyright (C) 2018 Marius Greuel
+// SPDX-License-Identifier: GPL-3.0-or-later
+//
+
+#pragma once
+#include <atl/autolock.h>
+#include <atl/ring_buffer.h>
+#include <stdint.h>
+
+// Logic-analyzer mode: the input capture ISRs queue every edge, and the main loop
+// packs them into packets for the CDC endpoint. A packet is
+//   [payload length] [edges lost since the last packet] [varint...]
+// where each varint holds (ticks since the previous edge << 1) | level, 7 bits per byte,
+// least significant group first. Edge times are 32-bit extended timer ticks, so gaps
+// longer than the 16-bit timer period keep their length. Deltas saturate at 2^31 - 1 ticks,
+// which is more than 1000s at clk/8.
+class EdgeCapture
+{
+    static const uint8_t queueSize = 64;
+    static const uint8_t headerSize = 2;
+    static const uint8_t maxVarIntSize = 5;
+    static const uint32_t maxDelta = 0x7FFFFFFF;
+
+    struct Edge
+    {
+        uint32_t m_time;
+        bool m_level;
+    };
+
+public:
+    static const uint8_t maxPacketSize = 64;
+
+    void Start(uint32_t time)
+    {
+        atl::AutoLock lock;
+        m_edges.Clear();
+        m_lastTime = time;
+        m_overruns = 0;
+        m_isActive = true;
+    }
+
+    void Stop()
+    {
+        m_isActive = false;
+    }
+
+    bool IsActive() const
+    {
+        return m_isActive;
+    }
+
+    void OnInputEdge(uint32_t time, bool level)
+    {
+        if (m_isActive)
+        {
+            if (!m_edges.Push(Edge{ time, level }) && m_overruns < 0xFF)
+            {
+                m_overruns++;
+            }
+        }
+    }
+
+    // Edges lost before they reached the capture, e.g. in the deferred decoding queue
+    void OnEdgesLost(uint8_t count)
+    {
+        if (m_isActive)
+        {
+            m_overruns = count < 0xFF - m_overruns ? m_overruns + count : 0xFF;
+        }
+    }
+
+    // Returns the size of the packet, or 0 if there is nothing to send.
+    uint8_t CreatePacket(uint8_t* packet)
+    {
+        uint8_t size = headerSize;
+        Edge edge;
+        while (size + maxVarIntSize <= maxPacketSize && m_edges.Pop(edge))
+        {
+            uint32_t delta = edge.m_time - m_lastTime;
+            m_lastTime = edge.m_time;
+            size = WriteVarInt(packet, size, ((delta <= maxDelta ? delta : maxDelta) << 1) | edge.m_level);
+        }
+
+        uint8_t overruns;
+        {
+            atl::AutoLock lock;
+            overruns = m_overruns;
+            m_overruns = 0;
+        }
+
+        if (size == headerSize && overruns == 0)
+            return 0;
+
+        packet[0] = size - headerSize;
+        packet[1] = overruns;
+        return size;
+    }
+
+private:
+    static uint8_t WriteVarInt(uint8_t* packet, uint8_t index, uint32_t value)
+    {
+        while (value >= 0x80)
+        {
+            packet[index++] = static_cast<uint8_t>(value) | 0x80;
+            value >>= 7;
+        }
+
+        packet[index++] = static_cast<uint8_t>(value);
+        return index;
+    }
+
+private:
+    atl::RingBuffer<Edge, queueSize> m_edges;
+    uint32_t m_lastTime = 0;
+    volatile uint8_t m_overruns = 0;
+    volatile bool m_isActive = false;
+};
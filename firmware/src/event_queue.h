@@ -0,0 +1,70 @@
+//
+// event_queue.h
+// Copyright (C) 2018 Marius Greuel
+// SPDX-License-Identifier: GPL-3.0-or-later
+//
+
+#pragma once
+#include <atl/ring_buffer.h>
+#include <stdint.h>
+
+// Input events queued by the ISRs for deferred decoding in the main loop.
+// Events that do not fit are dropped and counted; the count is handed out
+// with the next event, so the consumer knows exactly where the gap is.
+// The high-water mark is the largest number of events queued at once.
+template<typename T, uint8_t size>
+class EventQueueT
+{
+    struct Entry
+    {
+        T m_event;
+        uint8_t m_lostBefore;
+    };
+
+public:
+    // Called from the ISRs, which do not nest.
+    void Push(const T& event)
+    {
+        if (m_events.Push(Entry{ event, m_lost }))
+        {
+            m_lost = 0;
+
+            uint8_t count = m_events.GetCount();
+            if (count > m_highWaterMark)
+            {
+                m_highWaterMark = count;
+            }
+        }
+        else if (m_lost < 0xFF)
+        {
+            m_lost++;
+        }
+    }
+
+    // lostBefore receives the number of events dropped before this one.
+    bool Pop(T& event, uint8_t& lostBefore)
+    {
+        Entry entry;
+        if (!m_events.Pop(entry))
+            return false;
+
+        event = entry.m_event;
+        lostBefore = entry.m_lostBefore;
+        return true;
+    }
+
+    uint8_t GetHighWaterMark() const
+    {
+        return m_highWaterMark;
+    }
+
+    void ResetHighWaterMark()
+    {
+        m_highWaterMark = 0;
+    }
+
+private:
+    atl::RingBuffer<Entry, size> m_events;
+    uint8_t m_lost = 0;
+    volatile uint8_t m_highWaterMark = 0;
+};
@@ -6,6 +6,9 @@
 
 #define ATL_DEBUG 0
 
+// Size of the USB control endpoint, 8 or 64 bytes
+#define ATL_USB_CONTROL_ENDPOINT_SIZE 64
+
 // Enable decoding of PPM signals
 #define HIDRCJOY_PPM 1
 
@@ -24,9 +27,41 @@
 // Enable analog comparator input capture for A0/PF7 instead of ICP1
 #define HIDRCJOY_ICP_ACIC_A0 1
 
+// Use a 64-byte full-speed HID report with 16-bit axes, polled every 1ms
+#define HIDRCJOY_FULL_SPEED_REPORT 0
+
+// Enable streaming of raw input edges over the CDC interface, for use with a logic analyzer.
+// Its queue takes 320 bytes of SRAM, build with 'make EDGE_CAPTURE=1' to enable it.
+#ifndef HIDRCJOY_EDGE_CAPTURE
+#define HIDRCJOY_EDGE_CAPTURE 0
+#endif
+
+// Decode in the main loop, the ISRs only queue edges and bytes
+#define HIDRCJOY_DEFERRED_DECODING 0
+
 // Enable debugging via pins D9, D10, D11
 #define HIDRCJOY_DEBUG 0
 
+// Timer1 prescaler, 8 (0.5us at 16 MHz) or 1 (62.5ns, excludes SRXL)
+#define TIMER1_PRESCALER 8
+
+// Build for the simavr benchmark, set by 'make sim-bench'
+#ifndef HIDRCJOY_SIM
+#define HIDRCJOY_SIM 0
+#endif
+
+#if HIDRCJOY_SIM
+// simavr does not route the analog comparator to the input capture unit,
+// the benchmark drives ICP1 directly
+#undef HIDRCJOY_ICP_ACIC_A0
+#define HIDRCJOY_ICP_ACIC_A0 0
+
+// Decoders enabled by default, set by 'make sim-bench-masks'
+#ifndef HIDRCJOY_SIM_DECODER_MASK
+#define HIDRCJOY_SIM_DECODER_MASK Configuration::EnableAllDecoders
+#endif
+#endif
+
 #include <stdint.h>
 #include <string.h>
 #include <avr/eeprom.h>
@@ -41,7 +76,8 @@
 
 using namespace atl;
 
-#include <shared/system_timer1a.h>
+#include <shared/frame_snapshot.h>
+#include <shared/system_timer3.h>
 #include <shared/ppm_receiver.h>
 #include <shared/ppm_receiver_timer1b.h>
 #include <shared/pcm_receiver.h>
@@ -49,88 +85,220 @@ using namespace atl;
 #include <shared/srxl_receiver.h>
 #include <shared/srxl_receiver_timer1c.h>
 #include <shared/srxl_receiver_usart1.h>
+#include <shared/timer1_clock.h>
+#include "channel_calibration.h"
+#include "configuration_store.h"
+#include "decoder_monitor.h"
+#include "edge_capture.h"
+#include "event_queue.h"
 #include "hidrcjoy_board.h"
+#include "latency_statistics.h"
+#include "receiver_set.h"
+#include "sim_probe.h"
 #include "usb_reports.h"
 
 /////////////////////////////////////////////////////////////////////////////
 
 #define COUNTOF(x) (sizeof(x) / sizeof(x[0]))
 
+using SystemTimer = SystemTimer3;
+
 static Board g_board;
-static SystemTimer1A g_timer;
+static SystemTimer g_timer;
+static ExtendedTimer1 g_timer1;
 static Configuration g_configuration;
-static Configuration g_eepromConfiguration __attribute__((section(".eeprom")));
-static uint16_t g_updateRate;
+static ConfigurationSlot g_eepromConfigurationSlots[ConfigurationStore::slotCount] __attribute__((section(".eeprom")));
+static ConfigurationStore g_configurationStore(g_eepromConfigurationSlots);
+static volatile bool g_saveConfiguration;
+static uint32_t g_updateRate;
+static LatencyStatisticsT<Timer1Clock> g_latency;
 static bool g_invertedSignal;
+static volatile uint8_t g_decoderMask = Configuration::EnableAllDecoders;
+
+#if HIDRCJOY_EDGE_CAPTURE
+static EdgeCapture g_edgeCapture;
+#endif
+
+#if HIDRCJOY_DEFERRED_DECODING
+struct EdgeEvent
+{
+    enum Type : uint8_t
+    {
+        FallingEdge,
+        RisingEdge,
+        PpmSyncPause,
+    };
+
+    uint32_t m_time;
+    Type m_type;
+};
+
+struct ByteEvent
+{
+    enum Type : uint8_t
+    {
+        Data,
+        SrxlSyncPause,
+    };
+
+    uint32_t m_time;
+    uint8_t m_data;
+    Type m_type;
+};
+
+// An SRXL frame is 35 bytes, a PCM frame about 90 edges in 20ms.
+// Events carry the time the ISR took, so queueing does not shift the frame times.
+static EventQueueT<EdgeEvent, 32> g_edgeEvents;
+static EventQueueT<ByteEvent, 64> g_byteEvents;
+#endif
 
 #if HIDRCJOY_PPM
 class PpmReceiver : public PpmReceiverT<PpmReceiver, PpmReceiverTimer1B>
 {
+public:
+    DecoderMonitorT<Timer1Clock>& GetMonitor()
+    {
+        return m_monitor;
+    }
+
+private:
+    friend PpmReceiverT;
+
+    void OnFrameReceived(uint32_t time)
+    {
+        m_monitor.OnFrameReceived(time, GetChannelCount());
+    }
+
+    void OnError(DecoderError error)
+    {
+        m_monitor.OnError(error);
+    }
+
+    void OnTimeout()
+    {
+        m_monitor.OnTimeout();
+    }
+
+    DecoderMonitorT<Timer1Clock> m_monitor;
 };
 
 static PpmReceiver g_ppmReceiver;
+using PpmDecoder = DecoderT<PpmReceiver, &g_ppmReceiver, SignalSource::PPM>;
+#else
+using PpmDecoder = NoDecoder;
 #endif
 
 #if HIDRCJOY_PCM
 class PcmReceiver : public PcmReceiverT<PcmReceiver, PcmReceiverTimer1>
 {
+public:
+    DecoderMonitorT<Timer1Clock>& GetMonitor()
+    {
+        return m_monitor;
+    }
+
+private:
+    friend PcmReceiverT;
+
+    void OnFrameReceived(uint32_t time)
+    {
+        m_monitor.OnFrameReceived(time, GetChannelCount());
+    }
+
+    void OnError(DecoderError error)
+    {
+        m_monitor.OnError(error);
+    }
+
+    void OnTimeout()
+    {
+        m_monitor.OnTimeout();
+    }
+
+    DecoderMonitorT<Timer1Clock> m_monitor;
 };
 
 static PcmReceiver g_pcmReceiver;
+using PcmDecoder = DecoderT<PcmReceiver, &g_pcmReceiver, SignalSource::PCM>;
+#else
+using PcmDecoder = NoDecoder;
 #endif
 
 #if HIDRCJOY_SRXL
 class SrxlReceiver : public SrxlReceiverT<SrxlReceiver, SrxlReceiverTimer1C, SrxlReceiverUsart1>
 {
+public:
+    DecoderMonitorT<Timer1Clock>& GetMonitor()
+    {
+        return m_monitor;
+    }
+
+private:
+    friend SrxlReceiverT;
+
+    void OnFrameReceived(uint32_t time)
+    {
+        m_monitor.OnFrameReceived(time, GetChannelCount());
+    }
+
+    void OnError(DecoderError error)
+    {
+        m_monitor.OnError(error);
+    }
+
+    void OnTimeout()
+    {
+        m_monitor.OnTimeout();
+    }
+
+    DecoderMonitorT<Timer1Clock> m_monitor;
 };
 
 static SrxlReceiver g_srxlReceiver;
+using SrxlDecoder = DecoderT<SrxlReceiver, &g_srxlReceiver, SignalSource::SRXL>;
+#else
+using SrxlDecoder = NoDecoder;
 #endif
 
 //---------------------------------------------------------------------------
 
-class Receiver
+// The input edge interrupt is needed by PPM, PCM and the edge capture.
+static void UpdateInputEdgeInterrupt()
 {
-public:
-    void Initialize()
-    {
-#if HIDRCJOY_PPM
-        g_ppmReceiver.Initialize();
-#endif
-#if HIDRCJOY_PCM
-        g_pcmReceiver.Initialize();
-#endif
-#if HIDRCJOY_SRXL
-        g_srxlReceiver.Initialize();
+    bool enable = (g_decoderMask & (Configuration::EnablePpm | Configuration::EnablePcm)) != 0;
+#if HIDRCJOY_EDGE_CAPTURE
+    enable = enable || g_edgeCapture.IsActive();
 #endif
-    }
 
-    void Update()
+    AutoLock lock;
+#if HIDRCJOY_ICP & (HIDRCJOY_PPM || HIDRCJOY_PCM)
+    if (!enable)
     {
-        auto signalSource = SignalSource::None;
-
-#if HIDRCJOY_PPM
-        if (g_ppmReceiver.IsReceiving())
-        {
-            signalSource = SignalSource::PPM;
-        }
-#endif
-#if HIDRCJOY_PCM
-        if (g_pcmReceiver.IsReceiving())
-        {
-            signalSource = SignalSource::PCM;
-        }
-#endif
-#if HIDRCJOY_SRXL
-        if (g_srxlReceiver.IsReceiving())
-        {
-            signalSource = SignalSource::SRXL;
-        }
+        TIMSK1 &= ~_BV(ICIE1);
+    }
+    else if ((TIMSK1 & _BV(ICIE1)) == 0)
+    {
+        TIFR1 = _BV(ICF1);
+        TIMSK1 |= _BV(ICIE1);
+    }
 #endif
-
-        m_signalSource = signalSource;
+#if HIDRCJOY_PCINT
+    if (!enable)
+    {
+        PCICR &= ~_BV(PCIE0);
+    }
+    else if ((PCICR & _BV(PCIE0)) == 0)
+    {
+        PCIFR = _BV(PCIF0);
+        PCICR |= _BV(PCIE0);
     }
+#endif
+    ATL_UNUSED(enable);
+}
 
+class Receiver : public ReceiverSetT<PpmDecoder, PcmDecoder, SrxlDecoder>
+{
+public:
     void LoadDefaultConfiguration()
     {
         g_configuration.m_version = Configuration::version;
@@ -139,15 +307,42 @@ public:
         g_configuration.m_centerChannelPulseWidth = 1500;
         g_configuration.m_channelPulseWidthRange = 550;
         g_configuration.m_polarity = 0;
+        g_configuration.m_deadband = 0;
+        g_configuration.m_expo = 0;
+        g_configuration.m_reportPhase = 0;
+#if HIDRCJOY_SIM
+        g_configuration.m_decoderMask = HIDRCJOY_SIM_DECODER_MASK;
+#else
+        g_configuration.m_decoderMask = Configuration::EnableAllDecoders;
+#endif
+        g_configuration.m_lockFrames = 5;
+        g_configuration.m_lockTimeout = 1000;
 
         for (uint8_t i = 0; i < COUNTOF(g_configuration.m_mapping); i++)
         {
             g_configuration.m_mapping[i] = i;
+            g_configuration.m_minChannelPulseWidth[i] = 0;
+            g_configuration.m_maxChannelPulseWidth[i] = 0;
         }
     }
 
     void UpdateConfiguration()
     {
+        auto center = g_configuration.m_centerChannelPulseWidth;
+        auto range = g_configuration.m_channelPulseWidthRange;
+        for (uint8_t i = 0; i < COUNTOF(m_calibration); i++)
+        {
+            uint16_t minPulseWidth = i < MAX_CHANNELS ? g_configuration.m_minChannelPulseWidth[i] : 0;
+            uint16_t maxPulseWidth = i < MAX_CHANNELS ? g_configuration.m_maxChannelPulseWidth[i] : 0;
+            m_calibration[i].Initialize(
+                center,
+                minPulseWidth != 0 ? center - minPulseWidth : range,
+                maxPulseWidth != 0 ? maxPulseWidth - center : range,
+                g_configuration.m_deadband,
+                g_configuration.m_expo,
+                i < 8 && (g_configuration.m_polarity & (1 << i)) != 0);
+        }
+
 #if HIDRCJOY_PPM
         auto minSyncPulseWidth = g_configuration.m_minSyncPulseWidth;
         auto invertedSignal = (g_configuration.m_flags & Configuration::Flags::InvertedSignal) != 0;
@@ -156,203 +351,196 @@ public:
         g_ppmReceiver.SetMinSyncPulseWidth(minSyncPulseWidth);
         g_invertedSignal = invertedSignal;
 #endif
+
+        m_lockedSource = SignalSource::None;
+        EnableDecoders(g_configuration.m_decoderMask);
     }
 
-    bool IsValidConfiguration() const
+    // Runs all enabled decoders until one delivers m_lockFrames good frames in a row,
+    // then only that one until it has lost the signal for m_lockTimeout ms.
+    void Update(uint16_t time)
     {
-        if (g_configuration.m_version != Configuration::version)
+        ReceiverSetT::Update();
+
+        // The SetReport handler runs UpdateConfiguration() with interrupts enabled,
+        // so the decision and the decoder mask it applies must not interleave with it.
+        AutoLock lock;
+        if (g_configuration.m_lockFrames == 0)
+            return;
+
+        if (m_lockedSource == SignalSource::None)
+        {
+            auto signalSource = FindStableDecoder(g_configuration.m_lockFrames);
+            if (signalSource != SignalSource::None)
+            {
+                ATL_DEBUG_PRINT("Locked to source %u\n", static_cast<uint8_t>(signalSource));
+                m_lockedSource = signalSource;
+                m_lastReceiveTime = time;
+                EnableDecoders(g_configuration.m_decoderMask & (1 << (static_cast<uint8_t>(signalSource) - 1)));
+                ReceiverSetT::Update();
+            }
+        }
+        else if (IsReceiving())
+        {
+            m_lastReceiveTime = time;
+        }
+        else if (static_cast<uint16_t>(time - m_lastReceiveTime) >= g_configuration.m_lockTimeout)
+        {
+            ATL_DEBUG_PRINT("Lost source %u\n", static_cast<uint8_t>(m_lockedSource));
+            m_lockedSource = SignalSource::None;
+            EnableDecoders(g_configuration.m_decoderMask);
+        }
+    }
+
+    bool IsValidConfiguration(const Configuration& configuration) const
+    {
+        if (configuration.m_version != Configuration::version)
             return false;
 
-        if (g_configuration.m_minSyncPulseWidth < Configuration::minSyncWidth ||
-            g_configuration.m_minSyncPulseWidth > Configuration::maxSyncWidth)
+        if (configuration.m_minSyncPulseWidth < Configuration::minSyncWidth ||
+            configuration.m_minSyncPulseWidth > Configuration::maxSyncWidth)
             return false;
 
-        if (g_configuration.m_centerChannelPulseWidth < Configuration::minChannelPulseWidth ||
-            g_configuration.m_centerChannelPulseWidth > Configuration::maxChannelPulseWidth)
+        if (configuration.m_centerChannelPulseWidth < Configuration::minChannelPulseWidth ||
+            configuration.m_centerChannelPulseWidth > Configuration::maxChannelPulseWidth)
             return false;
 
-        if (g_configuration.m_channelPulseWidthRange < 10 ||
-            g_configuration.m_channelPulseWidthRange > Configuration::maxChannelPulseWidth)
+        if (configuration.m_channelPulseWidthRange < 10 ||
+            configuration.m_channelPulseWidthRange > Configuration::maxChannelPulseWidth)
             return false;
 
-        for (uint8_t i = 0; i < COUNTOF(g_configuration.m_mapping); i++)
+        if (configuration.m_deadband > Configuration::maxDeadband ||
+            configuration.m_deadband >= configuration.m_channelPulseWidthRange)
+            return false;
+
+        if (configuration.m_expo > Configuration::maxExpo)
+            return false;
+
+        if (configuration.m_reportPhase > Configuration::maxReportPhase)
+            return false;
+
+        if ((configuration.m_decoderMask & ~Configuration::EnableAllDecoders) != 0)
+            return false;
+
+        if (configuration.m_lockTimeout > Configuration::maxLockTimeout)
+            return false;
+
+        for (uint8_t i = 0; i < COUNTOF(configuration.m_mapping); i++)
         {
-            if (g_configuration.m_mapping[i] >= Configuration::maxInputChannels)
+            if (configuration.m_mapping[i] >= Configuration::maxInputChannels)
             {
                 return false;
             }
+
+            auto center = configuration.m_centerChannelPulseWidth;
+            auto minPulseWidth = configuration.m_minChannelPulseWidth[i];
+            if (minPulseWidth != 0 && !IsValidChannelRange(configuration, minPulseWidth, center))
+                return false;
+
+            auto maxPulseWidth = configuration.m_maxChannelPulseWidth[i];
+            if (maxPulseWidth != 0 && !IsValidChannelRange(configuration, center, maxPulseWidth))
+                return false;
         }
 
         return true;
     }
 
-    SignalSource GetSignalSource() const
+    // The pulse width in microseconds
+    uint16_t GetChannelData(const FrameSnapshot& frame, uint8_t channel) const
     {
-        return m_signalSource;
+        return FrameSnapshot::PulseWidthToUs(GetChannelPulseWidth(frame, channel));
     }
 
-    uint8_t GetChannelCount() const
+    uint8_t GetChannelValue(const FrameSnapshot& frame, uint8_t channel) const
     {
-        switch (m_signalSource)
-        {
-#if HIDRCJOY_PPM
-        case SignalSource::PPM:
-            return g_ppmReceiver.GetChannelCount();
-#endif
-#if HIDRCJOY_PCM
-        case SignalSource::PCM:
-            return g_pcmReceiver.GetChannelCount();
-#endif
-#if HIDRCJOY_SRXL
-        case SignalSource::SRXL:
-            return g_srxlReceiver.GetChannelCount();
-#endif
-        default:
-            return 0;
-        }
+        return PulseWidthToValue(channel, GetChannelData(frame, channel));
     }
 
-    uint16_t GetChannelData(uint8_t channel) const
+    // Calibrates the pulse width with its fraction of a microsecond
+    int16_t GetChannelFullValue(const FrameSnapshot& frame, uint8_t channel) const
     {
-        uint8_t index = g_configuration.m_mapping[channel];
-
-        switch (m_signalSource)
-        {
-#if HIDRCJOY_PPM
-        case SignalSource::PPM:
-            return g_ppmReceiver.GetChannelPulseWidth(index);
-#endif
-#if HIDRCJOY_PCM
-        case SignalSource::PCM:
-            return g_pcmReceiver.GetChannelPulseWidth(index);
-#endif
-#if HIDRCJOY_SRXL
-        case SignalSource::SRXL:
-            return g_srxlReceiver.GetChannelPulseWidth(index);
-#endif
-        default:
+        uint16_t value = GetChannelPulseWidth(frame, channel);
+        if (value == 0)
             return 0;
-        }
+
+        return m_calibration[channel].ApplyFixedPoint<FrameSnapshot::fractionBits>(value);
     }
 
-    uint8_t GetChannelValue(uint8_t channel) const
+private:
+    // Masks the interrupts of disabled decoders, the ISRs skip them as well.
+    void EnableDecoders(uint8_t decoderMask)
     {
-        uint8_t index = g_configuration.m_mapping[channel];
+        AutoLock lock;
+
+        uint8_t disabled = g_decoderMask & ~decoderMask;
+        uint8_t enabled = decoderMask & ~g_decoderMask;
+        g_decoderMask = decoderMask;
+
+        UpdateInputEdgeInterrupt();
 
-        switch (m_signalSource)
-        {
 #if HIDRCJOY_PPM
-        case SignalSource::PPM:
-            return PulseWidthToValue(channel, g_ppmReceiver.GetChannelPulseWidth(index));
-#endif
-#if HIDRCJOY_PCM
-        case SignalSource::PCM:
-            return PulseWidthToValue(channel, g_pcmReceiver.GetChannelPulseWidth(index));
-#endif
-#if HIDRCJOY_SRXL
-        case SignalSource::SRXL:
-            return PulseWidthToValue(channel, g_srxlReceiver.GetChannelPulseWidth(index));
-#endif
-        default:
-            return 0x80;
+        if ((disabled & Configuration::EnablePpm) != 0)
+        {
+            TIMSK1 &= ~_BV(OCIE1B);
+            g_ppmReceiver.Reset();
         }
-    }
-
-    bool IsReceiving() const
-    {
-        switch (m_signalSource)
+        else if ((enabled & Configuration::EnablePpm) != 0)
         {
-#if HIDRCJOY_PPM
-        case SignalSource::PPM:
-            return g_ppmReceiver.IsReceiving();
+            TIFR1 = _BV(OCF1B);
+            TIMSK1 |= _BV(OCIE1B);
+        }
 #endif
 #if HIDRCJOY_PCM
-        case SignalSource::PCM:
-            return g_pcmReceiver.IsReceiving();
+        if ((disabled & Configuration::EnablePcm) != 0)
+        {
+            g_pcmReceiver.Reset();
+        }
 #endif
 #if HIDRCJOY_SRXL
-        case SignalSource::SRXL:
-            return g_srxlReceiver.IsReceiving();
-#endif
-        default:
-            return false;
+        if ((disabled & Configuration::EnableSrxl) != 0)
+        {
+            TIMSK1 &= ~_BV(OCIE1C);
+            UCSR1B &= ~_BV(RXCIE1);
+            g_srxlReceiver.Reset();
         }
-    }
-
-    bool HasNewData() const
-    {
-        switch (m_signalSource)
+        else if ((enabled & Configuration::EnableSrxl) != 0)
         {
-#if HIDRCJOY_PPM
-        case SignalSource::PPM:
-            return g_ppmReceiver.HasNewData();
-#endif
-#if HIDRCJOY_PCM
-        case SignalSource::PCM:
-            return g_pcmReceiver.HasNewData();
-#endif
-#if HIDRCJOY_SRXL
-        case SignalSource::SRXL:
-            return g_srxlReceiver.HasNewData();
-#endif
-        default:
-            return false;
+            TIFR1 = _BV(OCF1C);
+            TIMSK1 |= _BV(OCIE1C);
+            UCSR1B |= _BV(RXCIE1);
         }
-    }
-
-    void ClearNewData()
-    {
-#if HIDRCJOY_PPM
-        g_ppmReceiver.ClearNewData();
-#endif
-#if HIDRCJOY_PCM
-        g_pcmReceiver.ClearNewData();
-#endif
-#if HIDRCJOY_SRXL
-        g_srxlReceiver.ClearNewData();
 #endif
     }
 
-private:
-    uint8_t PulseWidthToValue(uint8_t channel, uint16_t value) const
+    // Checks one half of a channel against the limits of the symmetric range
+    static bool IsValidChannelRange(const Configuration& configuration, uint16_t lower, uint16_t upper)
     {
-        if (value == 0)
-            return 0x80;
+        if (lower < Configuration::minChannelPulseWidth || upper > Configuration::maxChannelPulseWidth || lower >= upper)
+            return false;
 
-        int16_t center = g_configuration.m_centerChannelPulseWidth;
-        int16_t range = g_configuration.m_channelPulseWidthRange;
-        bool inverted = (g_configuration.m_polarity & (1 << channel)) != 0;
-        return SaturateValue(ScaleValue(InvertValue(static_cast<int16_t>(value) - center, inverted), range));
+        uint16_t range = upper - lower;
+        return range >= 10 && range > configuration.m_deadband;
     }
 
-    static int16_t InvertValue(int16_t value, bool inverted)
+    // The pulse width in the fixed point of FrameSnapshot
+    uint16_t GetChannelPulseWidth(const FrameSnapshot& frame, uint8_t channel) const
     {
-        return inverted ? -value : value;
+        uint8_t index = channel < COUNTOF(g_configuration.m_mapping) ? g_configuration.m_mapping[channel] : channel;
+        return index < FrameSnapshot::maxChannelCount ? frame.m_channelPulseWidth[index] : 0;
     }
 
-    static int16_t ScaleValue(int16_t value, int16_t range)
+    uint8_t PulseWidthToValue(uint8_t channel, uint16_t value) const
     {
-        return static_cast<int16_t>(128 + (128 * static_cast<int32_t>(value) / range));
-    }
+        if (value == 0)
+            return 0x80;
 
-    static uint8_t SaturateValue(int16_t value)
-    {
-        if (value < 0)
-        {
-            return 0;
-        }
-        else if (value > 255)
-        {
-            return 255;
-        }
-        else
-        {
-            return value;
-        }
+        return static_cast<uint8_t>(0x80 + (m_calibration[channel].Apply(value) >> 8));
     }
 
 private:
-    SignalSource m_signalSource = SignalSource::None;
+    ChannelCalibration m_calibration[FrameSnapshot::maxChannelCount];
+    volatile SignalSource m_lockedSource = SignalSource::None;
+    uint16_t m_lastReceiveTime = 0;
 } g_receiver;
 
 //---------------------------------------------------------------------------
@@ -365,9 +553,7 @@ static void LoadConfigurationDefaults()
 
 static void ReadConfigurationFromEeprom()
 {
-    eeprom_read_block(&g_configuration, &g_eepromConfiguration, sizeof(g_eepromConfiguration));
-
-    if (!g_receiver.IsValidConfiguration())
+    if (!g_configurationStore.Load(g_configuration) || !g_receiver.IsValidConfiguration(g_configuration))
     {
         g_receiver.LoadDefaultConfiguration();
     }
@@ -375,9 +561,29 @@ static void ReadConfigurationFromEeprom()
     g_receiver.UpdateConfiguration();
 }
 
+// Called from the SetReport handler, the main loop does the actual save.
 static void WriteConfigurationToEeprom()
 {
-    eeprom_write_block(&g_configuration, &g_eepromConfiguration, sizeof(g_eepromConfiguration));
+    g_saveConfiguration = true;
+}
+
+static void RunConfigurationStoreTask()
+{
+    if (g_saveConfiguration)
+    {
+        // The control requests change g_configuration from the USB interrupt,
+        // so take a copy and leave the CRC of the save to run with interrupts enabled
+        Configuration configuration;
+        {
+            AutoLock lock;
+            g_saveConfiguration = false;
+            configuration = g_configuration;
+        }
+
+        g_configurationStore.Save(configuration);
+    }
+
+    g_configurationStore.RunTask();
 }
 
 //---------------------------------------------------------------------------
@@ -405,9 +611,65 @@ class UsbDevice : public UsbCdcDeviceT<UsbDevice>
 
     static const uint8_t hidInterface = 2;
     static const uint8_t hidEndpoint = 4;
+#if HIDRCJOY_FULL_SPEED_REPORT
+    using Report = UsbFullSpeedReport;
+    static const uint8_t hidEndpointSize = 64;
+    static const uint8_t hidPollingInterval = 1; // 1ms
+#else
+    using Report = UsbReport;
     static const uint8_t hidEndpointSize = 8;
+    static const uint8_t hidPollingInterval = 10; // 10ms
+#endif
 
 public:
+    bool IsReportDue() const
+    {
+        if (!IsStartOfFrameAligned())
+            return true;
+
+        AutoLock lock;
+        if (!m_reportDue)
+            return false;
+
+        uint16_t elapsed = SystemTimer::TCNT() - m_startOfFrameTime;
+        return elapsed >= SystemTimer::UsToTicks(g_configuration.m_reportPhase);
+    }
+
+    // The capture time of the frame in the last report, from the same snapshot as its values
+    uint32_t GetFrameTime() const
+    {
+        AutoLock lock;
+        return m_frameTime;
+    }
+
+    uint32_t GetReportTime() const
+    {
+        return m_reportTime;
+    }
+
+    // The time from the frame of the last report to when the host read it, in us
+    uint16_t GetReportAge() const
+    {
+        AutoLock lock;
+        return m_reportAge;
+    }
+
+    // Applies a change of the report alignment to the configured HID endpoint,
+    // so it takes effect without the device being enumerated again.
+    // Called from the main loop, between reports.
+    void UpdateHidEndpoint()
+    {
+        AutoLock lock;
+        auto banks = GetHidEndpointBanks();
+        if (banks != m_hidEndpointBanks && IsConfigured())
+        {
+            ReleaseEndpoint(hidEndpoint);
+            ConfigureEndpoint(hidEndpoint, EndpointType::Interrupt, EndpointDirection::In, hidEndpointSize, banks);
+            ResetEndpoint(hidEndpoint);
+            m_hidEndpointBanks = banks;
+        }
+    }
+
     bool WriteReport()
     {
         if (IsConfigured())
@@ -415,10 +677,16 @@ public:
             UsbInEndpoint endpoint(hidEndpoint);
             if (endpoint.IsWriteAllowed())
             {
-                UsbReport report;
-                CreateReport(report);
+                Report report;
+                auto frameTime = CreateReport(report);
                 endpoint.WriteData(&report, sizeof(report), MemoryType::Ram);
                 endpoint.CompleteTransfer();
+                m_reportTime = g_timer1.GetTicks();
+                m_reportDue = false;
+
+                AutoLock lock;
+                m_frameTime = frameTime;
+                m_isReportPending = true;
                 return true;
             }
         }
@@ -426,29 +694,52 @@ public:
         return false;
     }
 
-    void CreateReport(UsbReport& report)
+    // Returns the capture time of the frame the report carries
+    uint32_t CreateReport(UsbReport& report)
+    {
+        FrameSnapshot frame;
+        g_receiver.GetFrame(frame);
+
+        report.m_reportId = UsbReportId;
+
+        for (uint8_t i = 0; i < COUNTOF(report.m_value); i++)
+        {
+            report.m_value[i] = g_receiver.GetChannelValue(frame, i);
+        }
+
+        return frame.m_time;
+    }
+
+    uint32_t CreateReport(UsbFullSpeedReport& report)
     {
+        FrameSnapshot frame;
+        g_receiver.GetFrame(frame);
+
         report.m_reportId = UsbReportId;
+        report.m_dummy = 0;
 
         for (uint8_t i = 0; i < COUNTOF(report.m_value); i++)
         {
-            report.m_value[i] = g_receiver.GetChannelValue(i);
+            report.m_value[i] = g_receiver.GetChannelFullValue(frame, i);
         }
+
+        return frame.m_time;
     }
 
     void CreateEnhancedReport(UsbEnhancedReport& report)
     {
-        auto signalSource = g_receiver.GetSignalSource();
-        auto channelCount = g_receiver.GetChannelCount();
+        FrameSnapshot frame;
+        g_receiver.GetFrame(frame);
 
         report.m_reportId = UsbEnhancedReportId;
-        report.m_signalSource = signalSource;
-        report.m_channelCount = channelCount;
+        report.m_signalSource = g_receiver.GetSignalSource();
+        report.m_channelCount = frame.m_channelCount;
         report.m_updateRate = g_updateRate;
+        report.m_reportAge = GetReportAge();
 
         for (uint8_t i = 0; i < COUNTOF(report.m_channelPulseWidth); i++)
         {
-            report.m_channelPulseWidth[i] = g_receiver.GetChannelData(i);
+            report.m_channelPulseWidth[i] = g_receiver.GetChannelData(frame, i);
         }
     }
 
@@ -458,16 +749,49 @@ private:
 
     void OnEventStartOfFrame()
     {
+        m_startOfFrameTime = SystemTimer::TCNT();
+        m_reportDue = true;
+        UpdateReportAge();
         base::Flush();
     }
 
+    // Once the host has read every bank of the HID endpoint, the age of the last report
+    // is the time from its frame to now. Checked once per frame, so it is up to 1ms late.
+    void UpdateReportAge()
+    {
+        if (!m_isReportPending || !IsConfigured())
+            return;
+
+        UsbSaveEndpoint endpoint(hidEndpoint);
+        if (GetBusyBanks() == 0)
+        {
+            uint32_t age = Timer1Clock::TicksToUs32(g_timer1.GetTicks() - m_frameTime);
+            m_reportAge = age <= 0xFFFF ? static_cast<uint16_t>(age) : 0xFFFF;
+            m_isReportPending = false;
+        }
+    }
+
     void OnEventConfigurationChanged()
     {
+        m_hidEndpointBanks = GetHidEndpointBanks();
         base::ConfigureEndpoints();
-        ConfigureEndpoint(hidEndpoint, EndpointType::Interrupt, EndpointDirection::In, hidEndpointSize, EndpointBanks::Two);
+        ConfigureEndpoint(hidEndpoint, EndpointType::Interrupt, EndpointDirection::In, hidEndpointSize, m_hidEndpointBanks);
         ResetAllEndpoints();
     }
 
+    // A second bank would hold a report back for another poll, so use a single bank when aligning to SOF
+    static EndpointBanks GetHidEndpointBanks()
+    {
+        return IsStartOfFrameAligned() ? EndpointBanks::One : EndpointBanks::Two;
+    }
+
+    // With a longer polling interval, a report written at the phase offset still waits
+    // for the frame the host polls in, so the alignment only applies to a 1ms interval.
+    static bool IsStartOfFrameAligned()
+    {
+        return hidPollingInterval == 1 && (g_configuration.m_flags & Configuration::Flags::StartOfFrameAlignedReport) != 0;
+    }
+
     void OnEventControlLineStateChanged()
     {
         ATL_DEBUG_PRINT("OnEventControlLineStateChanged: BaudRate=%lu, ControlLineState=0x%02X!\n", GetBaudRate(), GetControlLineState());
@@ -494,6 +818,38 @@ private:
             0xA1, 0x01,         // COLLECTION (Application)
             0x09, 0x01,         //   USAGE (Pointer)
             0x85, UsbReportId,  //   REPORT_ID (UsbReportId)
+#if HIDRCJOY_FULL_SPEED_REPORT
+            0x75, 0x08,         //   REPORT_SIZE (8 bits)
+            0x95, 0x01,         //   REPORT_COUNT (1)
+            0x81, 0x03,         //   INPUT (Cnst,Var,Abs)
+            // --- Axes ---
+            0xA1, 0x00,         //   COLLECTION (Physical)
+            0x09, 0x30,         //     USAGE (X)
+            0x09, 0x31,         //     USAGE (Y)
+            0x09, 0x32,         //     USAGE (Z)
+            0x09, 0x33,         //     USAGE (Rx)
+            0x09, 0x34,         //     USAGE (Ry)
+            0x09, 0x35,         //     USAGE (Rz)
+            0x09, 0x36,         //     USAGE (Slider)
+            0x09, 0x37,         //     USAGE (Dial)
+            0x09, 0x38,         //     USAGE (Wheel)
+            0x09, 0x40,         //     USAGE (Vx)
+            0x09, 0x41,         //     USAGE (Vy)
+            0x09, 0x42,         //     USAGE (Vz)
+            0x09, 0x43,         //     USAGE (Vbrx)
+            0x09, 0x44,         //     USAGE (Vbry)
+            0x09, 0x45,         //     USAGE (Vbrz)
+            0x09, 0x46,         //     USAGE (Vno)
+            0x16, 0x01, 0x80,   //     LOGICAL_MINIMUM (-32767)
+            0x26, 0xFF, 0x7F,   //     LOGICAL_MAXIMUM (32767)
+            0x75, 0x10,         //     REPORT_SIZE (16 bits)
+            0x95, UsbFullSpeedReport::channelCount, // REPORT_COUNT (16 axes)
+            0x81, 0x02,         //     INPUT (Data,Var,Abs)
+            0xC0,               //   END_COLLECTION (Physical)
+            0x15, 0x00,         //   LOGICAL_MINIMUM (0)
+            0x26, 0xFF, 0x00,   //   LOGICAL_MAXIMUM (255)
+            0x75, 0x08,         //   REPORT_SIZE (8 bits)
+#else
             // --- Joystick 1 ---
             0xA1, 0x00,         //   COLLECTION (Physical)
             0x09, 0x30,         //     USAGE (X)
@@ -525,6 +881,7 @@ private:
             0x95, 0x03,         //     REPORT_COUNT (3 sliders)
             0x81, 0x02,         //     INPUT (Data,Var,Abs)
             0xC0,               //   END_COLLECTION (Physical)
+#endif
             0xA1, 0x02,         //   COLLECTION (Logical)
             0x06, 0x00, 0xFF,   //     USAGE_PAGE (Vendor Defined Page 1)
             0x85, UsbEnhancedReportId, // REPORT_ID (UsbEnhancedReportId)
@@ -551,6 +908,30 @@ private:
             0x95, 0x01,         //     REPORT_COUNT (1)
             0x09, JumpToBootloaderId, // USAGE (...)
             0xB1, 0x02,         //     FEATURE (Data,Var,Abs)
+            0x85, UsbLatencyReportId, // REPORT_ID (...)
+            0x95, sizeof(struct UsbLatencyReport), // REPORT_COUNT (...)
+            0x09, UsbLatencyReportId, // USAGE (...)
+            0xB1, 0x02,         //     FEATURE (Data,Var,Abs)
+            0x85, ResetLatencyStatisticsId, // REPORT_ID (...)
+            0x95, 0x01,         //     REPORT_COUNT (1)
+            0x09, ResetLatencyStatisticsId, // USAGE (...)
+            0xB1, 0x02,         //     FEATURE (Data,Var,Abs)
+            0x85, DecoderStatisticsReportId, // REPORT_ID (...)
+            0x95, sizeof(struct UsbDecoderStatisticsReport), // REPORT_COUNT (...)
+            0x09, DecoderStatisticsReportId, // USAGE (...)
+            0xB1, 0x02,         //     FEATURE (Data,Var,Abs)
+            0x85, ResetDecoderStatisticsId, // REPORT_ID (...)
+            0x95, 0x01,         //     REPORT_COUNT (1)
+            0x09, ResetDecoderStatisticsId, // USAGE (...)
+            0xB1, 0x02,         //     FEATURE (Data,Var,Abs)
+            0x85, StartEdgeCaptureId, // REPORT_ID (...)
+            0x95, 0x01,         //     REPORT_COUNT (1)
+            0x09, StartEdgeCaptureId, // USAGE (...)
+            0xB1, 0x02,         //     FEATURE (Data,Var,Abs)
+            0x85, StopEdgeCaptureId, // REPORT_ID (...)
+            0x95, 0x01,         //     REPORT_COUNT (1)
+            0x09, StopEdgeCaptureId, // USAGE (...)
+            0xB1, 0x02,         //     FEATURE (Data,Var,Abs)
             0xC0,               //   END_COLLECTION (Logical)
             0xC0,               // END_COLLECTION (Application)
         };
@@ -589,7 +970,7 @@ private:
                 UsbEndpointAddressIn | hidEndpoint,
                 UsbEndpointTypeInterrupt,
                 hidEndpointSize,
-                10 // 10ms
+                hidPollingInterval
             },
         };
 
@@ -690,7 +1071,7 @@ private:
             {
             case UsbReportId:
             {
-                UsbReport report;
+                Report report;
                 CreateReport(report);
                 return WriteControlData(request.wLength, &report, sizeof(report), MemoryType::Ram);
             }
@@ -705,6 +1086,24 @@ private:
                 g_configuration.m_reportId = ConfigurationReportId;
                 return WriteControlData(request.wLength, &g_configuration, sizeof(g_configuration), MemoryType::Ram);
             }
+            case UsbLatencyReportId:
+            {
+                UsbLatencyReport report;
+                report.m_reportId = UsbLatencyReportId;
+                g_latency.CreateReport(report);
+                return WriteControlData(request.wLength, &report, sizeof(report), MemoryType::Ram);
+            }
+            case DecoderStatisticsReportId:
+            {
+                UsbDecoderStatisticsReport report = {};
+                report.m_reportId = DecoderStatisticsReportId;
+#if HIDRCJOY_DEFERRED_DECODING
+                report.m_edgeQueueHighWaterMark = g_edgeEvents.GetHighWaterMark();
+                report.m_byteQueueHighWaterMark = g_byteEvents.GetHighWaterMark();
+#endif
+                g_receiver.GetStatistics(report.m_statistics);
+                return WriteControlData(request.wLength, &report, sizeof(report), MemoryType::Ram);
+            }
             default:
                 return RequestStatus::NotHandled;
             }
@@ -716,7 +1115,15 @@ private:
             {
             case ConfigurationReportId:
             {
-                auto status = ReadControlData(&g_configuration, sizeof(g_configuration));
+                // Stall the status stage of a configuration the firmware cannot use
+                Configuration configuration;
+                UsbControlOutEndpoint endpoint;
+                endpoint.ReadData(&configuration, sizeof(configuration));
+                if (!g_receiver.IsValidConfiguration(configuration))
+                    return RequestStatus::Error;
+
+                g_configuration = configuration;
+                auto status = MapStatus(endpoint.CompleteTransfer());
                 g_receiver.UpdateConfiguration();
                 return status;
             }
@@ -735,6 +1142,34 @@ private:
                 WriteConfigurationToEeprom();
                 return ReadControlData(&reportId, sizeof(reportId));
             }
+            case ResetLatencyStatisticsId:
+            {
+                g_latency.Reset();
+                return ReadControlData(&reportId, sizeof(reportId));
+            }
+            case ResetDecoderStatisticsId:
+            {
+                g_receiver.ResetStatistics();
+#if HIDRCJOY_DEFERRED_DECODING
+                g_edgeEvents.ResetHighWaterMark();
+                g_byteEvents.ResetHighWaterMark();
+#endif
+                return ReadControlData(&reportId, sizeof(reportId));
+            }
+#if HIDRCJOY_EDGE_CAPTURE
+            case StartEdgeCaptureId:
+            {
+                g_edgeCapture.Start(g_timer1.GetTicks());
+                UpdateInputEdgeInterrupt();
+                return ReadControlData(&reportId, sizeof(reportId));
+            }
+            case StopEdgeCaptureId:
+            {
+                g_edgeCapture.Stop();
+                UpdateInputEdgeInterrupt();
+                return ReadControlData(&reportId, sizeof(reportId));
+            }
+#endif
             case JumpToBootloaderId:
             {
                 ReadControlData(&reportId, sizeof(reportId));
@@ -756,49 +1191,50 @@ private:
         Detach();
         Bootloader::ResetToBootloader();
     }
+
+private:
+    uint32_t m_frameTime = 0;
+    uint32_t m_reportTime = 0;
+    EndpointBanks m_hidEndpointBanks = EndpointBanks::Two;
+    volatile uint16_t m_startOfFrameTime = 0;
+    volatile uint16_t m_reportAge = 0;
+    volatile bool m_reportDue = false;
+    volatile bool m_isReportPending = false;
 } g_usbDevice;
 
 //---------------------------------------------------------------------------
 
-#if HIDRCJOY_ICP & (HIDRCJOY_PPM || HIDRCJOY_PCM)
-ISR(TIMER1_CAPT_vect)
+// Hands an input edge to the edge capture and the edge decoders,
+// from the edge ISR, or from the main loop with deferred decoding.
+static void DecodeInputEdge(uint32_t time, bool risingEdge)
 {
-    uint16_t time = ICR1;
-    bool risingEdge = (TCCR1B & _BV(ICES1)) != 0;
-
-#if HIDRCJOY_ICP_ACIC_A0
-    risingEdge = !risingEdge;
+#if HIDRCJOY_EDGE_CAPTURE
+    g_edgeCapture.OnInputEdge(time, risingEdge);
 #endif
 
-    if (g_invertedSignal)
-    {
-        risingEdge = !risingEdge;
-    }
-
-#if HIDRCJOY_DEBUG
-    g_board.m_debug.SetD9(risingEdge);
-#endif
+    uint8_t decoderMask = g_decoderMask;
+    ATL_UNUSED(decoderMask);
 
 #if HIDRCJOY_PPM
-    if (risingEdge)
+    if (risingEdge && (decoderMask & Configuration::EnablePpm) != 0)
     {
+#if HIDRCJOY_DEFERRED_DECODING
+        g_ppmReceiver.OnDeferredEdge(time);
+#else
         g_ppmReceiver.OnInputEdge(time);
+#endif
     }
 #endif
 #if HIDRCJOY_PCM
-    g_pcmReceiver.OnInputEdge(time, risingEdge);
+    if ((decoderMask & Configuration::EnablePcm) != 0)
+    {
+        g_pcmReceiver.OnInputEdge(time, risingEdge);
+    }
 #endif
-
-    TCCR1B ^= _BV(ICES1);
 }
-#endif
 
-#if HIDRCJOY_PCINT
-ISR(PCINT0_vect)
+static void OnInputEdge(uint32_t time, bool risingEdge)
 {
-    uint16_t time = TCNT1;
-    bool risingEdge = (PPM_PCINT_PIN & _BV(PPM_PCINT_BIT)) != 0;
-
     if (g_invertedSignal)
     {
         risingEdge = !risingEdge;
@@ -808,28 +1244,55 @@ ISR(PCINT0_vect)
     g_board.m_debug.SetD9(risingEdge);
 #endif
 
+#if HIDRCJOY_DEFERRED_DECODING
 #if HIDRCJOY_PPM
-    if (risingEdge)
+    // The sync timeout runs from the edge, not from when the main loop gets to it
+    if (risingEdge && (g_decoderMask & Configuration::EnablePpm) != 0)
     {
-        g_ppmReceiver.OnInputEdge(time);
+        g_ppmReceiver.StartSyncTimeout(time);
     }
 #endif
-#if HIDRCJOY_PCM
-    g_pcmReceiver.OnInputEdge(time, risingEdge);
+
+    g_edgeEvents.Push(EdgeEvent{ time, risingEdge ? EdgeEvent::RisingEdge : EdgeEvent::FallingEdge });
+#else
+    DecodeInputEdge(time, risingEdge);
 #endif
 }
-#endif
 
-ISR(TIMER1_COMPA_vect)
+#if HIDRCJOY_ICP & (HIDRCJOY_PPM || HIDRCJOY_PCM)
+ISR(TIMER1_CAPT_vect)
 {
-    g_timer.OnOutputCompare();
+    uint32_t time = g_timer1.ExtendTicks(ICR1);
+    bool risingEdge = (TCCR1B & _BV(ICES1)) != 0;
 
-#if HIDRCJOY_PCM
-    g_pcmReceiver.RunTask();
+#if HIDRCJOY_ICP_ACIC_A0
+    risingEdge = !risingEdge;
 #endif
-#if HIDRCJOY_SRXL
-    g_srxlReceiver.RunTask();
+
+    OnInputEdge(time, risingEdge);
+
+    TCCR1B ^= _BV(ICES1);
+}
 #endif
+
+#if HIDRCJOY_PCINT
+ISR(PCINT0_vect)
+{
+    uint32_t time = g_timer1.ExtendTicks(TCNT1);
+    bool risingEdge = (PPM_PCINT_PIN & _BV(PPM_PCINT_BIT)) != 0;
+
+    OnInputEdge(time, risingEdge);
+}
+#endif
+
+ISR(TIMER1_OVF_vect)
+{
+    g_timer1.OnOverflow();
+}
+
+ISR(TIMER3_OVF_vect)
+{
+    g_timer.OnOverflow();
 }
 
 #if HIDRCJOY_PPM
@@ -839,21 +1302,34 @@ ISR(TIMER1_COMPB_vect)
     g_board.m_debug.ToggleD10();
 #endif
 
+#if HIDRCJOY_DEFERRED_DECODING
+    g_edgeEvents.Push(EdgeEvent{ OCR1B, EdgeEvent::PpmSyncPause });
+#else
     g_ppmReceiver.OnOutputCompare();
+#endif
 }
 #endif
 
 #if HIDRCJOY_SRXL
 ISR(TIMER1_COMPC_vect)
 {
+#if HIDRCJOY_DEFERRED_DECODING
+    g_byteEvents.Push(ByteEvent{ 0, 0, ByteEvent::SrxlSyncPause });
+#else
     g_srxlReceiver.OnOutputCompare();
+#endif
 }
 #endif
 
 #if HIDRCJOY_SRXL
 ISR(USART1_RX_vect)
 {
-    g_srxlReceiver.OnDataReceived(UDR1);
+#if HIDRCJOY_DEFERRED_DECODING
+    g_srxlReceiver.StartSyncTimeout();
+    g_byteEvents.Push(ByteEvent{ g_timer1.ExtendTicks(TCNT1), UDR1, ByteEvent::Data });
+#else
+    g_srxlReceiver.OnDataReceived(UDR1, g_timer1.ExtendTicks(TCNT1));
+#endif
 }
 #endif
 
@@ -867,12 +1343,106 @@ ISR(USB_COM_vect)
     g_usbDevice.OnEndpointInterrupt();
 }
 
+static bool IsEdgeCaptureActive()
+{
+#if HIDRCJOY_EDGE_CAPTURE
+    return g_edgeCapture.IsActive();
+#else
+    return false;
+#endif
+}
+
+#if HIDRCJOY_DEFERRED_DECODING
+// Decodes everything the ISRs have queued since the last pass, so each event is
+// decoded within one pass of the main loop. An event waits for at most the rest of
+// the pass it arrived in plus the decoding of the events queued before it, at most
+// the high-water mark of its queue. The latency statistics include this wait, as
+// the frame times are the ISR times. After a queue overrun, the decoders drop the
+// frame the lost events belonged to and resynchronize.
+static void RunDeferredDecoding()
+{
+    EdgeEvent edgeEvent;
+    uint8_t lostEdges;
+    while (g_edgeEvents.Pop(edgeEvent, lostEdges))
+    {
+        if (lostEdges != 0)
+        {
+#if HIDRCJOY_EDGE_CAPTURE
+            g_edgeCapture.OnEdgesLost(lostEdges);
+#endif
+#if HIDRCJOY_PPM
+            g_ppmReceiver.DiscardFrame();
+            g_ppmReceiver.GetMonitor().OnEventsLost(lostEdges);
+#endif
+#if HIDRCJOY_PCM
+            g_pcmReceiver.DiscardFrame();
+            g_pcmReceiver.GetMonitor().OnEventsLost(lostEdges);
+#endif
+        }
+
+        if (edgeEvent.m_type == EdgeEvent::PpmSyncPause)
+        {
+#if HIDRCJOY_PPM
+            g_ppmReceiver.OnDeferredSyncPause();
+#endif
+        }
+        else
+        {
+            DecodeInputEdge(edgeEvent.m_time, edgeEvent.m_type == EdgeEvent::RisingEdge);
+        }
+    }
+
+#if HIDRCJOY_SRXL
+    ByteEvent byteEvent;
+    uint8_t lostBytes;
+    while (g_byteEvents.Pop(byteEvent, lostBytes))
+    {
+        if (lostBytes != 0)
+        {
+            g_srxlReceiver.DiscardFrame();
+            g_srxlReceiver.GetMonitor().OnEventsLost(lostBytes);
+        }
+
+        if (byteEvent.m_type == ByteEvent::SrxlSyncPause)
+        {
+            g_srxlReceiver.OnDeferredSyncPause();
+        }
+        else
+        {
+            g_srxlReceiver.OnDeferredData(byteEvent.m_data, byteEvent.m_time);
+        }
+    }
+#endif
+}
+#endif
+
+// Checks the decoder timeouts, which are deadlines against the millisecond time.
+static void RunDecoderTasks(uint16_t time)
+{
+    ATL_UNUSED(time);
+
+#if HIDRCJOY_PCM
+    if ((g_decoderMask & Configuration::EnablePcm) != 0)
+    {
+        g_pcmReceiver.RunTask(time);
+    }
+#endif
+#if HIDRCJOY_SRXL
+    if ((g_decoderMask & Configuration::EnableSrxl) != 0)
+    {
+        g_srxlReceiver.RunTask(time);
+    }
+#endif
+}
+
 //---------------------------------------------------------------------------
 
 int main(void)
 {
     g_board.Initialize();
     g_timer.Initialize();
+    Timer1Clock::Start();
+    g_timer1.Initialize();
     g_receiver.Initialize();
     g_usbDevice.Attach();
 
@@ -896,6 +1466,7 @@ int main(void)
     ADMUX = _BV(MUX2) | _BV(MUX1) | _BV(MUX0);
 #endif
 
+    g_configurationStore.Initialize();
     ReadConfigurationFromEeprom();
 
     Watchdog::Enable(Watchdog::Timeout::Time250ms);
@@ -907,24 +1478,37 @@ int main(void)
 
     SignalSource lastSource = SignalSource::None;
     uint16_t lastLedUpdate = 0;
-    uint16_t lastUsbUpdate = 0;
+    uint32_t lastReportTicks = 0;
     for (;;)
     {
         Watchdog::Reset();
 
+#if HIDRCJOY_SIM
+        SimProbe::OnMainLoop();
+#endif
+
         auto time = g_timer.GetMilliseconds();
         g_board.RunTask(time);
 
-        g_receiver.Update();
+        RunConfigurationStoreTask();
+        g_usbDevice.UpdateHidEndpoint();
+#if HIDRCJOY_DEFERRED_DECODING
+        RunDeferredDecoding();
+#endif
+        RunDecoderTasks(time);
+
+        g_receiver.Update(time);
         if (g_receiver.IsReceiving())
         {
-            if (g_receiver.HasNewData())
+            if (g_receiver.HasNewData() && g_usbDevice.IsReportDue())
             {
                 if (g_usbDevice.WriteReport())
                 {
-                    g_updateRate = time - lastUsbUpdate;
+                    g_latency.AddSample(g_usbDevice.GetFrameTime(), g_usbDevice.GetReportTime());
+                    auto reportTicks = g_timer.GetTicks();
+                    g_updateRate = SystemTimer::TicksToUs32(reportTicks - lastReportTicks);
+                    lastReportTicks = reportTicks;
                     lastLedUpdate = time;
-                    lastUsbUpdate = time;
 
                     LED_PORT |= _BV(LED_BIT);
                     g_receiver.ClearNewData();
@@ -933,7 +1517,7 @@ int main(void)
         }
         else
         {
-            if (time - lastLedUpdate >= 1000)
+            if (static_cast<uint16_t>(time - lastLedUpdate) >= 1000)
             {
                 lastLedUpdate = time;
                 LED_PIN |= _BV(LED_BIT);
@@ -942,8 +1526,35 @@ int main(void)
             g_usbDevice.WriteReport();
         }
 
+#if HIDRCJOY_SIM
+        // There is no USB host to take the reports, so hand the frames to the harness
+        if (g_receiver.HasNewData())
+        {
+            FrameSnapshot frame;
+            g_receiver.GetFrame(frame);
+            SimProbe::OnFrame(g_receiver.GetSignalSource(), frame);
+            g_receiver.ClearNewData();
+        }
+#endif
+
+#if HIDRCJOY_EDGE_CAPTURE
+        if (g_edgeCapture.IsActive())
+        {
+            if (g_usbDevice.GetWriteSpace() >= EdgeCapture::maxPacketSize)
+            {
+                uint8_t packet[EdgeCapture::maxPacketSize];
+                uint8_t size = g_edgeCapture.CreatePacket(packet);
+                if (size > 0)
+                {
+                    g_usbDevice.WriteData(packet, size);
+                }
+            }
+        }
+#endif
+
+        // Keep text out of the CDC stream while edges are captured
         auto signalSource = g_receiver.GetSignalSource();
-        if (signalSource != lastSource)
+        if (signalSource != lastSource && !IsEdgeCaptureActive())
         {
             printf_P(PSTR("Signal source: %u\n"), (uint8_t)signalSource);
             lastSource = signalSource;
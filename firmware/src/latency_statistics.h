@@ -0,0 +1,108 @@
+//
+// latency_statistics.h
+// Copyright (C) 2018 Marius Greuel
+// SPDX-License-Identifier: GPL-3.0-or-later
+//
+
+#pragma once
+#include <atl/autolock.h>
+#include <stdint.h>
+#include "usb_reports.h"
+
+// Collects the time from a completed frame to the report that carries it
+// being committed to the HID endpoint. Samples are added from the main loop,
+// reports are read from the control request handler.
+template<class timer>
+class LatencyStatisticsT
+{
+public:
+    void Reset()
+    {
+        atl::AutoLock lock;
+        m_count = 0;
+        m_sum = 0;
+        m_sumCount = 0;
+        m_last = 0;
+        m_min = 0xFFFF;
+        m_max = 0;
+
+        for (uint8_t i = 0; i < UsbLatencyReport::histogramSize; i++)
+        {
+            m_histogram[i] = 0;
+        }
+    }
+
+    // Times are 32-bit extended ticks, latencies saturate at 65535us.
+    void AddSample(uint32_t frameTime, uint32_t reportTime)
+    {
+        uint32_t elapsed = timer::TicksToUs32(reportTime - frameTime);
+        uint16_t latency = elapsed <= 0xFFFF ? static_cast<uint16_t>(elapsed) : 0xFFFF;
+
+        uint8_t bin = latency >> UsbLatencyReport::histogramShift;
+        if (bin >= UsbLatencyReport::histogramSize)
+        {
+            bin = UsbLatencyReport::histogramSize - 1;
+        }
+
+        atl::AutoLock lock;
+        m_last = latency;
+        m_count++;
+
+        // Halve the running sum before it can overflow, which keeps the average
+        if ((m_sumCount & 0x8000) != 0)
+        {
+            m_sum >>= 1;
+            m_sumCount >>= 1;
+        }
+
+        m_sum += latency;
+        m_sumCount++;
+
+        if (latency < m_min)
+        {
+            m_min = latency;
+        }
+
+        if (latency > m_max)
+        {
+            m_max = latency;
+        }
+
+        if (m_histogram[bin] < 0xFFFF)
+        {
+            m_histogram[bin]++;
+        }
+    }
+
+    uint16_t GetLastLatency() const
+    {
+        atl::AutoLock lock;
+        return m_last;
+    }
+
+    void CreateReport(UsbLatencyReport& report) const
+    {
+        atl::AutoLock lock;
+        report.m_histogramShift = UsbLatencyReport::histogramShift;
+        report.m_frameAge = m_last;
+        report.m_minLatency = m_count > 0 ? m_min : 0;
+        report.m_avgLatency = m_sumCount > 0 ? static_cast<uint16_t>(m_sum / m_sumCount) : 0;
+        report.m_maxLatency = m_max;
+        report.m_dummy = 0;
+        report.m_reportCount = m_count;
+
+        for (uint8_t i = 0; i < UsbLatencyReport::histogramSize; i++)
+        {
+            report.m_histogram[i] = m_histogram[i];
+        }
+    }
+
+private:
+    uint32_t m_count = 0;
+    uint32_t m_sum = 0;
+    uint16_t m_sumCount = 0;
+    uint16_t m_last = 0;
+    uint16_t m_min = 0xFFFF;
+    uint16_t m_max = 0;
+    uint16_t m_histogram[UsbLatencyReport::histogramSize] = {};
+};
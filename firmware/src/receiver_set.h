@@ -0,0 +1,195 @@
+//
+// receiver_set.h
+// Copyright (C) 2018 Marius Greuel
+// SPDX-License-Identifier: GPL-3.0-or-later
+//
+
+#pragma once
+#include <atl/memory.h>
+#include <shared/frame_snapshot.h>
+#include <stdint.h>
+#include "usb_reports.h"
+
+// Binds a decoder instance to the signal source it reports.
+template<typename T, T* decoder, SignalSource source>
+struct DecoderT
+{
+    static const SignalSource signalSource = source;
+
+    static void Initialize() { decoder->Initialize(); }
+    static bool IsReceiving() { return decoder->IsReceiving(); }
+    static bool HasNewData() { return decoder->HasNewData(); }
+    static void ClearNewData() { decoder->ClearNewData(); }
+    static void GetFrame(FrameSnapshot& frame) { decoder->GetFrame(frame); }
+    static uint8_t GetConsecutiveFrames() { return decoder->GetMonitor().GetConsecutiveFrames(); }
+    static void GetStatistics(DecoderStatistics& statistics) { decoder->GetMonitor().GetStatistics(statistics); }
+    static void ResetStatistics() { decoder->GetMonitor().ResetStatistics(); }
+};
+
+// Stands in for a decoder that is compiled out, and for "no signal".
+struct NoDecoder
+{
+    static const SignalSource signalSource = SignalSource::None;
+
+    static void Initialize() {}
+    static bool IsReceiving() { return false; }
+    static bool HasNewData() { return false; }
+    static void ClearNewData() {}
+    static void GetFrame(FrameSnapshot& frame) { frame = FrameSnapshot(); }
+    static uint8_t GetConsecutiveFrames() { return 0; }
+    static void GetStatistics(DecoderStatistics&) {}
+    static void ResetStatistics() {}
+};
+
+struct DecoderOps
+{
+    SignalSource m_signalSource;
+    void (*m_initialize)();
+    bool (*m_isReceiving)();
+    bool (*m_hasNewData)();
+    void (*m_clearNewData)();
+    void (*m_getFrame)(FrameSnapshot& frame);
+    uint8_t (*m_getConsecutiveFrames)();
+    void (*m_getStatistics)(DecoderStatistics& statistics);
+    void (*m_resetStatistics)();
+};
+
+template<typename T>
+constexpr DecoderOps MakeDecoderOps()
+{
+    return DecoderOps
+    {
+        T::signalSource,
+        &T::Initialize,
+        &T::IsReceiving,
+        &T::HasNewData,
+        &T::ClearNewData,
+        &T::GetFrame,
+        &T::GetConsecutiveFrames,
+        &T::GetStatistics,
+        &T::ResetStatistics,
+    };
+}
+
+// Dispatches to the decoder that currently receives a signal.
+// Update() resolves it to an index into a table of function pointers in
+// program memory, all other calls are a table read and a single indirect call.
+// Entry 0 is NoDecoder.
+// A single byte index can be read from interrupt handlers without a lock.
+// When several decoders receive, the last one in the list wins.
+template<typename... Decoders>
+class ReceiverSetT
+{
+    static const uint8_t count = 1 + sizeof...(Decoders);
+
+public:
+    void Initialize()
+    {
+        for (uint8_t i = 1; i < count; i++)
+        {
+            Read(m_decoders[i].m_initialize)();
+        }
+    }
+
+    void Update()
+    {
+        uint8_t active = 0;
+        for (uint8_t i = 1; i < count; i++)
+        {
+            if (Read(m_decoders[i].m_isReceiving)())
+            {
+                active = i;
+            }
+        }
+
+        m_active = active;
+    }
+
+    SignalSource GetSignalSource() const
+    {
+        return GetSignalSource(m_active);
+    }
+
+    bool IsReceiving() const
+    {
+        return Read(GetActive().m_isReceiving)();
+    }
+
+    bool HasNewData() const
+    {
+        return Read(GetActive().m_hasNewData)();
+    }
+
+    void GetFrame(FrameSnapshot& frame) const
+    {
+        Read(GetActive().m_getFrame)(frame);
+    }
+
+    // Returns the last receiving decoder with at least frameCount good frames in a row.
+    SignalSource FindStableDecoder(uint8_t frameCount) const
+    {
+        auto signalSource = SignalSource::None;
+        for (uint8_t i = 1; i < count; i++)
+        {
+            if (Read(m_decoders[i].m_isReceiving)() && Read(m_decoders[i].m_getConsecutiveFrames)() >= frameCount)
+            {
+                signalSource = GetSignalSource(i);
+            }
+        }
+
+        return signalSource;
+    }
+
+    void ClearNewData()
+    {
+        for (uint8_t i = 1; i < count; i++)
+        {
+            Read(m_decoders[i].m_clearNewData)();
+        }
+    }
+
+    // statistics is indexed by SignalSource - 1
+    void GetStatistics(DecoderStatistics* statistics) const
+    {
+        for (uint8_t i = 1; i < count; i++)
+        {
+            auto signalSource = GetSignalSource(i);
+            if (signalSource != SignalSource::None)
+            {
+                Read(m_decoders[i].m_getStatistics)(statistics[static_cast<uint8_t>(signalSource) - 1]);
+            }
+        }
+    }
+
+    void ResetStatistics()
+    {
+        for (uint8_t i = 1; i < count; i++)
+        {
+            Read(m_decoders[i].m_resetStatistics)();
+        }
+    }
+
+private:
+    const DecoderOps& GetActive() const
+    {
+        return m_decoders[m_active];
+    }
+
+    static SignalSource GetSignalSource(uint8_t index)
+    {
+        return static_cast<SignalSource>(atl::ProgmemTraits::ReadUInt8(reinterpret_cast<const uint8_t*>(&m_decoders[index].m_signalSource)));
+    }
+
+    template<typename F>
+    static F Read(const F& function)
+    {
+        return atl::ProgmemTraits::ReadPointer(&function);
+    }
+
+private:
+    static const DecoderOps m_decoders[count];
+    volatile uint8_t m_active = 0;
+};
+
+template<typename... Decoders>
+const DecoderOps ReceiverSetT<Decoders...>::m_decoders[] PROGMEM = { MakeDecoderOps<NoDecoder>(), MakeDecoderOps<Decoders>()... };
@@ -0,0 +1,45 @@
+//
+// sim_probe.h
+// Copyright (C) 2018 Marius Greuel
+// SPDX-License-Identifier: GPL-3.0-or-later
+//
+
+#pragma once
+#include <avr/io.h>
+#include <shared/frame_snapshot.h>
+#include <stdint.h>
+#include "usb_reports.h"
+
+// Markers for the simavr benchmark in sim/sim_bench.cpp, built with 'make sim-bench'.
+// The harness watches writes to the general purpose I/O registers, which take
+// a single cycle each. It measures the ISR cycles itself, from the simulator's
+// interrupt state, so the ISRs carry no markers.
+class SimProbe
+{
+public:
+    enum Marker : uint8_t
+    {
+        MainLoop = 1,
+        Frame = 2,
+    };
+
+    static void OnMainLoop()
+    {
+        GPIOR0 = Marker::MainLoop;
+    }
+
+    // A decoded frame follows on GPIOR1: the signal source, the channel count,
+    // and the pulse width of each channel in us, low byte first.
+    static void OnFrame(SignalSource signalSource, const FrameSnapshot& frame)
+    {
+        GPIOR0 = Marker::Frame;
+        GPIOR1 = static_cast<uint8_t>(signalSource);
+        GPIOR1 = frame.m_channelCount;
+        for (uint8_t i = 0; i < frame.m_channelCount; i++)
+        {
+            uint16_t pulseWidth = FrameSnapshot::PulseWidthToUs(frame.m_channelPulseWidth[i]);
+            GPIOR1 = static_cast<uint8_t>(pulseWidth);
+            GPIOR1 = static_cast<uint8_t>(pulseWidth >> 8);
+        }
+    }
+};
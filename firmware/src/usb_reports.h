@@ -18,6 +18,12 @@ enum ReportId
     ReadConfigurationFromEepromId,
     WriteConfigurationToEepromId,
     JumpToBootloaderId,
+    UsbLatencyReportId,
+    ResetLatencyStatisticsId,
+    DecoderStatisticsReportId,
+    ResetDecoderStatisticsId,
+    StartEdgeCaptureId,
+    StopEdgeCaptureId,
 };
 
 enum class SignalSource : uint8_t
@@ -36,12 +42,62 @@ struct UsbReport
 
 static_assert(sizeof(UsbReport) <= 8, "Report size for low-speed devices may not exceed 8 bytes");
 
+struct UsbFullSpeedReport
+{
+    static const uint8_t channelCount = 16;
+
+    uint8_t m_reportId;
+    uint8_t m_dummy;
+    int16_t m_value[channelCount];
+};
+
+static_assert(sizeof(UsbFullSpeedReport) <= 64, "Report size for full-speed devices may not exceed 64 bytes");
+
 struct UsbEnhancedReport
 {
     uint8_t m_reportId;
     SignalSource m_signalSource;
     uint8_t m_channelCount;
     uint8_t m_dummy;
-    uint32_t m_updateRate;
+    uint32_t m_updateRate; // us between reports
     uint16_t m_channelPulseWidth[Configuration::maxOutputChannels];
+    uint16_t m_reportAge;
+};
+
+struct UsbLatencyReport
+{
+    static const uint8_t histogramSize = 16;
+    static const uint8_t histogramShift = 10; // 1024us per bin
+
+    uint8_t m_reportId;
+    uint8_t m_histogramShift;
+    uint16_t m_frameAge;
+    uint16_t m_minLatency;
+    uint16_t m_avgLatency;
+    uint16_t m_maxLatency;
+    uint16_t m_dummy;
+    uint32_t m_reportCount;
+    uint16_t m_histogram[histogramSize];
+};
+
+struct DecoderStatistics
+{
+    uint32_t m_frames;
+    uint16_t m_checksumErrors;
+    uint16_t m_shortFrames;
+    uint16_t m_longFrames;
+    uint16_t m_timeouts;
+    uint16_t m_channelCountChanges;
+    uint16_t m_framePeriod; // us
+    uint16_t m_frameJitter; // us, smoothed difference of consecutive periods
+    uint16_t m_lostEvents; // deferred decoding queue overruns
+};
+
+struct UsbDecoderStatisticsReport
+{
+    uint8_t m_reportId;
+    uint8_t m_edgeQueueHighWaterMark; // deferred decoding, most events queued at once
+    uint8_t m_byteQueueHighWaterMark;
+    uint8_t m_dummy;
+    DecoderStatistics m_statistics[3]; // indexed by SignalSource - 1
 };
@@ -238,7 +238,7 @@ public:
             pConfiguration->m_minSyncPulseWidth = static_cast<uint16_t>(GetIntegerValue(m_ecMinSyncPulseWidth));
             pConfiguration->m_centerChannelPulseWidth = static_cast<uint16_t>(GetIntegerValue(m_ecCenterChannelPulseWidth));
             pConfiguration->m_channelPulseWidthRange = static_cast<uint16_t>(GetIntegerValue(m_ecChannelPulseWidthRange));
-            pConfiguration->m_flags = static_cast<uint8_t>(m_btInvertedSignal.GetCheck() == BST_CHECKED ? Configuration::InvertedSignal : 0);
+            pConfiguration->m_flags = static_cast<uint8_t>((pConfiguration->m_flags & ~Configuration::InvertedSignal) | (m_btInvertedSignal.GetCheck() == BST_CHECKED ? Configuration::InvertedSignal : 0));
 
             UpdateDeviceConfiguration();
         }
@@ -565,7 +565,7 @@ private:
                 break;
             }
 
-            uint32_t updateRate = report.m_updateRate > 0 ? 1000 / report.m_updateRate : 0;
+            uint32_t updateRate = report.m_updateRate > 0 ? 1000000 / report.m_updateRate : 0;
             m_stDeviceStatus.SetWindowText(FormatString(_T("Receiving data using %s at %uHz"), strSignalSource.GetString(), updateRate));
         }
 